@@ -42,6 +42,13 @@ data CCodeGenConfig = CCodeGenConfig
     -- ^ Maps external modules to the namespaces to use for the
     -- types in them.
   , cfgLazyStreams  :: !Bool
+  , cfgSegmentedStack :: !Bool
+    -- ^ Use contiguous stack segments instead of a linked list of closures
+  , cfgErrorTracking :: !Bool
+    -- ^ Keep track of the best parse error.  If this is false, the
+    -- parser only reports if the parse succeeded.
+  , cfgBTreeMaps :: !Bool
+    -- ^ Represent maps with B-trees instead of red-black trees
   }
 
 
@@ -60,6 +67,9 @@ cProgram
     , cfgExtraInclude = extraIncludes
     , cfgExternal     = ext
     , cfgLazyStreams  = lazy
+    , cfgSegmentedStack = segStack
+    , cfgErrorTracking = trackErrors
+    , cfgBTreeMaps = btreeMaps
     }
     prog =
   case checkProgram prog of
@@ -67,6 +77,15 @@ cProgram
     Just err -> panic "cProgram" err
   where
   inpType = if lazy then "DDL::Stream" else "DDL::Input"
+  stackType = if segStack then "DDL::SegStack" else "DDL::ListStack"
+  mapType   = if btreeMaps then "DDL::BTreeMap" else "DDL::Map"
+
+  -- Template arguments for the parser state, after the input type
+  -- (and user state), if they are not the defaults.
+  stateArgs
+    | not trackErrors = [ stackType, "DDL::NoErrorTracking" ]
+    | segStack        = [ stackType ]
+    | otherwise       = []
 
   externalMap = Map.fromList [ (Src.MName x, text y) | (x,y) <- Map.toList ext ]
 
@@ -76,8 +95,11 @@ cProgram
           ]
 
 
-  hpp = let ?nsUser = nsUserParam
+  hpp = let ?userState = userState
+            ?parserStateArgs = stateArgs
+            ?nsUser = nsUserParam
             ?nsInputType = inpType
+            ?nsMapType = mapType
             ?nsExternal = externalMap
         in
         vcat $
@@ -96,8 +118,10 @@ cProgram
           capRootSigs
 
   cpp = let ?userState = userState
+            ?parserStateArgs = stateArgs
             ?nsUser = nsUserParam
             ?nsInputType = inpType
+            ?nsMapType = mapType
             ?nsExternal = externalMap
         in
         vcat $ [ "#include" <+> doubleQuotes (text fileNameRoot <.> ".h")
@@ -120,8 +144,10 @@ cProgram
 
   primSigs =
     let ?userState = userState
+        ?parserStateArgs = stateArgs
         ?nsUser = nsUserParam
         ?nsInputType = inpType
+        ?nsMapType = mapType
         ?nsExternal = externalMap
     in case prims of
          [] -> []
@@ -134,8 +160,10 @@ cProgram
     let ?allFuns = allFunMap
         ?allTypes = allTypesMap
         ?userState = userState
+        ?parserStateArgs = stateArgs
         ?nsUser = nsUserParam
         ?nsInputType = inpType
+        ?nsMapType = mapType
         ?nsExternal = externalMap
     in concatMap cFun noCapFun
 
@@ -146,8 +174,10 @@ cProgram
      let ?allFuns  = allFunMap
          ?allTypes = allTypesMap
          ?userState = userState
+         ?parserStateArgs = stateArgs
          ?nsUser = nsUserParam
          ?nsInputType = inpType
+         ?nsMapType = mapType
          ?nsExternal = externalMap
      in unzip (map cNonCaptureRoot noCapRoots)
 
@@ -155,8 +185,10 @@ cProgram
   capRoots                   = [ f | f <- capFuns, vmfIsEntry f ]
   (capEnts,capBlocks)        =
     let ?userState = userState
+        ?parserStateArgs = stateArgs
         ?nsUser = nsUserParam
         ?nsInputType = inpType
+        ?nsMapType = mapType
         ?nsExternal = externalMap
     in unzip (zipWith cCaptureEntryDef [0..] capRoots)
   (cEntCode,cEntFuns,cEntTs) = unzip3 capEnts
@@ -167,8 +199,10 @@ cProgram
         ?captures = Capture
         ?allTypes = allTypesMap
         ?userState = userState
+        ?parserStateArgs = stateArgs
         ?nsUser    = nsUserParam
         ?nsInputType = inpType
+        ?nsMapType = mapType
         ?nsExternal = externalMap
     in defineCaptureParser cEntTs cEntCode capFuns
 
@@ -194,7 +228,7 @@ cProgram
 
 includes :: CCodeGenConfig -> Doc
 includes opts =
-  vcat $ maybeStream ++
+  vcat $ maybeStream ++ maybeBTree ++
        [ "#include <ddl/parser.h>"
        , "#include <ddl/size.h>"
        , "#include <ddl/input.h>"
@@ -213,9 +247,13 @@ includes opts =
        , "#include <optional>"
        ]
   where maybeStream = [ "<ddl/stream.h>" | cfgLazyStreams opts ]
+        maybeBTree  = [ "#include <ddl/btree_map.h>" | cfgBTreeMaps opts ]
 
 
-type UserState  = (?userState :: Maybe CType, NSUser)
+type UserState  = ( ?userState :: Maybe CType
+                  , ?parserStateArgs :: [CType]
+                  , NSUser
+                  )
 type AllFuns    = (?allFuns   :: Map Src.FName VMFun)
 type AllTypes   = (?allTypes  :: Map Src.TName Src.TDecl)
 type AllBlocks  = (?allBlocks :: Map Label Block)
@@ -248,8 +286,8 @@ findExternFunsWithDef ext = map vmfName . filter warn
 parserStateType :: UserState => CType
 parserStateType =
   case ?userState of
-    Nothing -> cInst "DDL::ParserState" [ nsInputType ]
-    Just t  -> cInst "DDL::ParserStateUser" [ nsInputType, t ]
+    Nothing -> cInst "DDL::ParserState" ([ nsInputType ] ++ ?parserStateArgs)
+    Just t  -> cInst "DDL::ParserStateUser" ([ nsInputType, t ] ++ ?parserStateArgs)
 
 parseErrorType :: NSUser => CType
 parseErrorType = cInst "DDL::ParseError" [ nsInputType ]
@@ -281,9 +319,9 @@ declareParserState =
 cCaptureParserSig :: UserState => Doc
 cCaptureParserSig =
   "static void" <+>
-  cCall "parser" ([ "EntryArgs entry" ] ++
-                  userStateArgDecl ++
-                  [ parseErrorType <+> "&err"
+  cCall "parser" ([ "EntryArgs entry"
+                  , parserStateType <+> "&p"
+                  , parseErrorType <+> "&err"
                   , "void* out"
                   ])
 
@@ -297,8 +335,7 @@ defineCaptureParser entTs ents capFuns
   where
   def = cCaptureParserSig <+> "{" $$ nest 2 (vcat body) $$ "}"
   body =
-    [ declareParserState
-    , "clang_bug_workaround: void *clang_bug = &&clang_bug_workaround;"
+    [ "clang_bug_workaround: void *clang_bug = &&clang_bug_workaround;"
     , vcat (map cDeclareBlockParams (Map.elems ?allBlocks))
     , cDeclareRetVars capFuns
     , cDeclareClosures (Map.elems ?allBlocks)
@@ -365,24 +402,70 @@ cDeclareClosures bs =
 --------------------------------------------------------------------------------
 -- Entry Points
 
+-- The argument is the type of the container for the results.
 standardEntryArgs :: UserState => CType -> [Doc]
-standardEntryArgs ty =
+standardEntryArgs resT =
   userStateArgDecl ++
   [ parseErrorType <+> "&error"
-  , cInst "std::vector" [ ty ] <+> "&results"
+  , resT <+> "&results"
   ]
 
+resultSinkType :: CType -> CType
+resultSinkType ty = cInst "DDL::ResultSink" [ ty ]
+
+{- | Each entry point comes in three versions, with different names, so that
+  taking the address of `parseF` still works as it used to:
+  * `parseFWithState` runs the parser in a given parser state, which is
+    reset first, and sends the results to a `DDL::ResultSink`.
+    The values made by the parser are allocated in the arena of
+    the parser state (when the runtime is compiled with `DDL_ARENA`).
+    This is for doing many parses without allocating a new parser state
+    for each one.
+  * `parseFToSink` is the same, but uses a fresh parser state.
+  * `parseF` collects all results in a vector, by using a sink
+    without a limit.
+The body is for `parseFWithState`, and uses the parser state `p`.
+Returns the signatures and the definitions of all versions. -}
+cEntryFuns ::
+  UserState => Src.FName -> CType -> [(CType,CExpr)] -> [CStmt] -> (CDecl,CDecl)
+cEntryFuns f ty args body =
+  ( vcat [ cStmt stateSig, cStmt sinkSig, cStmt vecSig ]
+  , vcat [ stateSig <+> "{" $$ nest 2 (vcat stateBody) $$ "}"
+         , sinkSig  <+> "{" $$ nest 2 (vcat sinkBody) $$ "}"
+         , vecSig   <+> "{" $$ nest 2 (vcat vecBody) $$ "}"
+         ]
+  )
   where
+  stateNm  = cFEntryStateName f
+  sinkNm   = cFEntrySinkName f
+  argDecls = map (uncurry (<+>)) args
+  sig nm as = "void" <+> nm <+> cArgBlock (as ++ argDecls)
+  stateSig = sig stateNm [ parserStateType <+> "&p"
+                         , parseErrorType <+> "&error"
+                         , resultSinkType ty <+> "&results"
+                         ]
+  sinkSig  = sig sinkNm (standardEntryArgs (resultSinkType ty))
+  vecSig   = sig (cFEntryName f)
+                 (standardEntryArgs (cInst "std::vector" [ ty ]))
+
+  stateBody = cStmt (cCallMethod "p" "reset" [])
+            : cDeclareConVar "DDL::ArenaScope" "arena"
+                             [ cCallMethod "p" "valueArena" [] ]
+            : body
+  sinkBody  =
+    [ declareParserState
+    , cStmt (cCall stateNm ([ "p", "error", "results" ] ++ map snd args))
+    ]
+  vecBody  =
+    [ cDeclareConVar (resultSinkType ty) "sink" [ "results" ]
+    , cStmt (cCall sinkNm (userStateArg ++ [ "error", "sink" ] ++ map snd args))
+    ]
 
 cCaptureEntryFun ::
   (UserState,NSUser) => Int -> Src.FName -> [VMT] -> (CDecl,CDecl)
-cCaptureEntryFun n f as =
-  (cStmt sig, sig <+> "{" $$ nest 2 body $$ "}")
+cCaptureEntryFun n f as = cEntryFuns f ty args [body]
   where
-  nm   = cFEntryName f
   ty   = cSemType (Src.fnameType f)
-  sig  = "void" <+> nm <+>
-                  cArgBlock (standardEntryArgs ty ++ map (uncurry (<+>)) args)
   args = [ (cType t, "a" <.> int i) | (t,i) <- zip as [0..] ]
   ent  = vcat [ "{ .tag =" <+> int n
               , ", .args = { ." <.> capEntryName n <+> "= {"
@@ -391,7 +474,7 @@ cCaptureEntryFun n f as =
               ]
   argVs = [ "." <.> capArgName i <+> "=" <+> a | (i,(_,a)) <- zip [0..] args ]
   body =
-    cStmt (cCall "parser" ([ ent ] ++ userStateArg ++ ["error", "&results" ]))
+    cStmt (cCall "parser" [ ent, "p", "error", "&results" ])
 
 
 cDeclareEntryArgs :: [CDecl] -> CDecl
@@ -422,8 +505,9 @@ cCaptureEntryDef n fun =
            ]
 
   doPush l =
-    let clo = cCall (cReturnClassName []) ["&&" <.> cBlockLabel l]
-    in cStmt (cCall "p.push" ["new" <+> clo])
+    let clo = cCall (cInst "p.alloc" [cReturnClassName []])
+                    ["&&" <.> cBlockLabel l]
+    in cStmt (cCall "p.push" [clo])
 
   getArg ent a ba =
     cAssign (cArgUse entryBlock ba)
@@ -482,12 +566,8 @@ cCaptureEntryDef n fun =
 
 -- Entry point for a non-capturing parser: siganture,defintiion
 cNonCaptureRoot :: (UserState,AllTypes,AllFuns,NSUser) => VMFun -> (CDecl,CDecl)
-cNonCaptureRoot fun = (cStmt sig, sig <+> "{" $$ nest 2 (vcat body) $$ "}")
+cNonCaptureRoot fun = cEntryFuns name ty pargs body
   where
-  sig = "void" <+> cname <+>
-                   cArgBlock (standardEntryArgs ty ++ map (uncurry (<+>)) pargs)
-
-  cname = cFEntryName name
   name  = vmfName fun
 
   normalArgs = [ cType (getType x)
@@ -503,11 +583,10 @@ cNonCaptureRoot fun = (cStmt sig, sig <+> "{" $$ nest 2 (vcat body) $$ "}")
   call = cCall (cFName name)
                ([ "p", "&out_result", "&out_input" ] ++ map snd pargs)
 
-  body = [ declareParserState
-         , cDeclareVar ty "out_result"
+  body = [ cDeclareVar ty "out_result"
          , cDeclareVar nsInputType "out_input"
          , cIf call
-              [ cStmt (cCallMethod "results" "push_back" [ "out_result" ])
+              [ cStmt (cCallMethod "results" "push" [ "out_result" ])
               , cStmt (cCallMethod "out_input" "free" [])
               ]
               [ cAssign "error" (cCallMethod "p" "getParseError" [])]
@@ -515,12 +594,16 @@ cNonCaptureRoot fun = (cStmt sig, sig <+> "{" $$ nest 2 (vcat body) $$ "}")
 
 
 
--- Declare the result of an entry
-delcareEntryResults :: NSUser => [VMFun] -> CDecl
-delcareEntryResults es = cNamespace "DDL" [ cNamespace "ResultOf" (map ty es) ]
+-- Declare the result of an entry, and the parser state it uses
+delcareEntryResults :: UserState => [VMFun] -> CDecl
+delcareEntryResults es =
+  cNamespace "DDL" [ cNamespace "ResultOf" (map ty es)
+                   , cNamespace "ParserStateOf" (map st es)
+                   ]
   where
   ty e = let n = vmfName e
          in cUsingT (cFEntryName n) (cSemType (Src.fnameType n))
+  st e = cUsingT (cFEntryName (vmfName e)) parserStateType
 
 
 
@@ -701,9 +784,10 @@ cBlockStmt cInstr =
                    DebugTailCall -> "true"
                    DebugCall     -> "false"
     PopDebug        -> cStmt (cCall "p.popDebug"  [])
-    Output e        -> let t = cPtrT (cInst "std::vector" [ cType (getType e) ])
+    Output e        -> let t = cPtrT (resultSinkType (cType (getType e)))
                            o = parens (parens(t) <.> "out")
-                       in cStmt (cCall (o <.> "->push_back") [ cExpr e ])
+                       in cIf' ("!" <.> cCall (o <.> "->push") [ cExpr e ])
+                            [ cStmt (cCall "p.discardSuspended" []) ]
     Notify e        -> cStmt (cCall "p.notify"   [ cExpr e ])
     NoteFail err loc i m ->
       cStmt (cCall "p.noteFail" [ sys, cString loc, cExpr i, cExpr m ])
@@ -711,7 +795,7 @@ cBlockStmt cInstr =
                     Src.ErrorFromSystem -> "true"
                     Src.ErrorFromUser   -> "false"
     Spawn x l       -> cVarDecl x (cCall "p.spawn" [clo])
-      where clo = "new" <+> cCall (cThreadClassName (map getType (jArgs l)))
+      where clo = cCall (cInst "p.alloc" [cThreadClassName (map getType (jArgs l))])
                     ("&&" <.> cBlockLabel (jLabel l) : map cExpr (jArgs l))
 
     Free xs         -> vcat (cFree xs)
@@ -731,12 +815,23 @@ cBlockStmt cInstr =
 
         NewBuilder _ -> cDeclareVar (cType (getType x)) (cVarUse x)
         Integer n    -> cVarDecl x (cCall "DDL::Integer" [ cString (show n) ])
-        ByteArray bs -> cVarDecl x
-                              (cCallCon "DDL::Array<DDL::UInt<8>>"
-                                [ cCall "DDL::UInt<8>"
-                                              [ text (show w) <> "UL" ]
-                                  | w <- BS.unpack bs
-                                ])
+        ByteArray bs
+          | BS.null bs -> cVarDecl x (cCallCon "DDL::Array<DDL::UInt<8>>" [])
+
+          -- Literals are allocated once, and each use gets a reference
+          | otherwise ->
+            let ty    = cType (getType x)
+                owned = cInst "DDL::Owned" [ty]
+                lit   = "lit_" <.> cVarUse x
+                bytes = cCall (cInst "reinterpret_cast" ["DDL::UInt<8> const*"])
+                              [ cBytes (BS.unpack bs) ]
+            in vcat
+                 [ cDeclareInitVar ("static thread_local" <+> owned) lit
+                     $ cCall owned
+                         [ cCall (ty .:: "literal")
+                                 [ bytes, text (show (BS.length bs)) ] ]
+                 , cVarDecl x (cCallMethod lit "get" [])
+                 ]
         Op1 op1      -> cOp1 x op1 es
         Op2 op2      -> cOp2 x op2 es
         Op3 op3      -> cOp3 x op3 es
@@ -1051,7 +1146,7 @@ cExpr expr =
                              , show (pp ty) ]
 
 
-    EMapEmpty k v -> cCallCon (cInst "DDL::Map" [ cSemType k, cSemType v ]) []
+    EMapEmpty k v -> cCallCon (cInst nsMapType [ cSemType k, cSemType v ]) []
     ENothing t  -> parens (cCall (cInst "DDL::Maybe" [cSemType t]) [])
 
 
@@ -1187,9 +1282,9 @@ cTermStmt ccInstr =
                Nothing  -> panic "cTermStmt" [ "Unknown function", show (pp f) ]
 
   doPush l =
-    let clo = cCall (cReturnClassName (map getType (jArgs l)))
+    let clo = cCall (cInst "p.alloc" [cReturnClassName (map getType (jArgs l))])
                     ("&&" <.> cBlockLabel (jLabel l) : map cExpr (jArgs l))
-    in cStmt (cCall "p.push" ["new" <+> clo])
+    in cStmt (cCall "p.push" [clo])
 
 
 cDoJump :: (Copies,CurBlock,CaptureFun, NSUser) => Block -> [E] -> [CStmt]
@@ -1,6 +1,8 @@
 {-# Language OverloadedStrings #-}
 module Daedalus.VM.Backend.C.Lang where
 
+import Data.Word(Word8)
+import Numeric(showOct)
 import Text.PrettyPrint as P
 import Daedalus.PP
 
@@ -28,6 +30,15 @@ cCallMethod x f es = cCall (x <.> "." <.> f) es
 cString :: String -> CExpr
 cString = text . show
 
+-- | A string literal with the given bytes.  We use octal escapes
+-- for all bytes, as they have at most 3 digits, so they are not affected
+-- by the characters that follow them (unlike hex escapes).
+cBytes :: [Word8] -> CExpr
+cBytes ws = doubleQuotes (text (concatMap esc ws))
+  where
+  esc w = let ds = showOct w ""
+          in '\\' : replicate (3 - length ds) '0' ++ ds
+
 cSelect :: CExpr -> CExpr -> CExpr
 cSelect x l = x <.> "." <.> l
 
@@ -27,6 +27,9 @@ type NSUser = ( ?nsUser :: Doc
               , ?nsInputType :: Doc
                 -- ^ Use this type to represent input streams
 
+              , ?nsMapType :: Doc
+                -- ^ Use this type to represent maps
+
 
               , ?nsExternal :: Map Src.MName Doc
                 -- extrenal modules with corresponding namespace
@@ -39,6 +42,9 @@ nsUser = ?nsUser
 nsInputType :: NSUser => Doc
 nsInputType = ?nsInputType
 
+nsMapType :: NSUser => Doc
+nsMapType = ?nsMapType
+
 nsPrivate :: Doc
 nsPrivate = "Private"
 
@@ -197,6 +203,16 @@ cFNameInit = cFNameWithPref "init_"
 cFEntryName :: FName -> CIdent
 cFEntryName f = escText ("parse" <> Src.fnameText f)
 
+-- | The version of an entry point that uses a given parser state,
+-- and sends its results to a `DDL::ResultSink`.
+cFEntryStateName :: FName -> CIdent
+cFEntryStateName f = escText ("parse" <> Src.fnameText f <> "WithState")
+
+-- | The version of an entry point that sends its results to
+-- a `DDL::ResultSink`.
+cFEntrySinkName :: FName -> CIdent
+cFEntrySinkName f = escText ("parse" <> Src.fnameText f <> "ToSink")
+
 
 
 --------------------------------------------------------------------------------
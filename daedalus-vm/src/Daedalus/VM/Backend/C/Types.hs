@@ -31,13 +31,13 @@ cSemType sty =
     Src.TUnit       -> "DDL::Unit"
     Src.TArray t    -> cInst "DDL::Array" [ cSemType t ]
     Src.TMaybe t    -> cInst "DDL::Maybe" [ cSemType t ]
-    Src.TMap k v    -> cInst "DDL::Map" [ cSemType k, cSemType v ]
+    Src.TMap k v    -> cInst nsMapType [ cSemType k, cSemType v ]
     Src.TBuilder t  -> cInst "DDL::Builder" [ cSemType t ]
 
     Src.TIterator t ->
       case t of
         Src.TArray a  -> cInst "DDL::Array" [ cSemType a ] <.> "::Iterator"
-        Src.TMap k v  -> cInst "DDL::Map" [ cSemType k, cSemType v]
+        Src.TMap k v  -> cInst nsMapType [ cSemType k, cSemType v]
                                                           <.> "::Iterator"
         _ -> panic "cSemType" [ "Unexpected iterator type", show (pp t) ]
     Src.TUser ut               -> cTUser ut
@@ -67,6 +67,9 @@ data Options =
           , optExternMods :: Map Text String
             -- ^ maps external module to namespace qualifier in generated code
           , optUseLazyStream :: Bool
+          , optSegmentedStack :: Bool
+          , optErrorTracking :: Bool
+          , optBTreeMaps :: Bool
 
           , optModulePath :: [String]
             -- ^ Search for modules in these paths
@@ -112,6 +115,9 @@ defaultOptions =
           , optModulePath = []
           , optDetailedErrors = Nothing
           , optUseLazyStream = False
+          , optSegmentedStack = False
+          , optErrorTracking = True
+          , optBTreeMaps = False
           }
 
 defaultUserSpace :: String
@@ -396,6 +402,19 @@ cmdCompileCPPOptions = (\o -> o { optCommand = CompileCPP }, opts)
         "The parser can context switch to ask for more data."
         $ NoArg \o -> Right o { optUseLazyStream = True }
 
+      , Option [] ["segmented-stack"]
+        "Keep the parser stack in contiguous segments."
+        $ NoArg \o -> Right o { optSegmentedStack = True }
+
+      , Option [] ["no-error-tracking"]
+        "Only report if the parse succeeded, without any error information."
+        $ NoArg \o -> Right o { optErrorTracking = False
+                              , optErrorStacks = False }
+
+      , Option [] ["btree-maps"]
+        "Represent maps with B-trees instead of red-black trees."
+        $ NoArg \o -> Right o { optBTreeMaps = True }
+
       ] ++
       coreOptions ++
       [ helpOption
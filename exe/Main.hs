@@ -327,6 +327,9 @@ generateCPP opts mm =
                   , cfgExtraInclude = optExtraInclude opts
                   , cfgExternal     = optExternMods opts
                   , cfgLazyStreams  = optUseLazyStream opts
+                  , cfgSegmentedStack = optSegmentedStack opts
+                  , cfgErrorTracking = optErrorTracking opts
+                  , cfgBTreeMaps = optBTreeMaps opts
                   }
          (hpp,cpp,warns) = C.cProgram ccfg prog
 
@@ -1,10 +1,6 @@
 #include <iostream>
 #include <chrono>
-#include <fcntl.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <sys/mman.h>
-#include <unistd.h>
+#include <ddl/file_input.h>
 #include <ddl/float.h>
 #include <ddl/json.h>
 #include "main_parser.h"
@@ -12,30 +8,6 @@
 using namespace std;
 
 
-DDL::Input inputFromFile(const char *file) {
-
-  DDL::Input result{};
-  char *bytes;
-  size_t size;
-
-  int fd = open(file,O_RDONLY);
-  if (fd == -1) return result;
-
-  struct stat info;
-  if (fstat(fd, &info) != 0) goto done;
-
-  size = info.st_size;
-  bytes = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
-  if (bytes == MAP_FAILED) goto done;
-
-  result = DDL::Input{file,bytes,size};
-
-done:
-  close(fd);
-  return result;
-}
-
-
 int main(int argc, char* argv[]) {
 
   bool timed = false;
@@ -64,8 +36,7 @@ int main(int argc, char* argv[]) {
     i = DDL::Input("(none)","");
   } else {
     char *file = argv[fileArg];
-    i = inputFromFile(file);
-    if (i.length() == 0) {
+    if (!DDL::inputFromFile(file, &i)) {
       // Does not escape quotes...
       cout << "Failed to open file \"" << file << '"' << endl;
       return 1;
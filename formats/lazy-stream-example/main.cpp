@@ -5,6 +5,11 @@
 
 #include "main_parser.h"
 
+static
+void deleteString(void *s, const char *) {
+  delete static_cast<std::string*>(s);
+}
+
 int main() {
 
   DDL::ParseError<DDL::Stream> err;
@@ -27,7 +32,7 @@ int main() {
       delete s;
       pt.finish();
     } else {
-      pt.append(n,s->c_str(),[s]() { delete s; });
+      pt.append(n,s->c_str(),deleteString,s);
     }
     pt.resume();
   }
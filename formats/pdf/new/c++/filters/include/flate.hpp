@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The output of `FlateDecode`, in a buffer allocated with `malloc`.
+// The caller owns `data`, and should release it with `free`.
+struct FlateOutput {
+  char   *data;
+  size_t  size;
+};
+
+// Decompress a zlib stream.  The output buffer starts at `sizeHint`
+// bytes (or an estimate based on `n`, if the hint is 0), and doubles
+// when it fills up.  Truncated streams decode to the bytes before
+// the end of the input.  Returns false if the data is corrupt.
+bool FlateDecode(uint8_t const* bytes, size_t n, size_t sizeHint, FlateOutput &out);
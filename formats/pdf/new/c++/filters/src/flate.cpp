@@ -0,0 +1,84 @@
+#include "flate.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+#include <zlib.h>
+
+namespace {
+  // Deflate cannot expand data by more than this factor.
+  size_t const maxRatio = 1032;
+  size_t const minSize  = 4096;
+
+  size_t initialSize(size_t n, size_t sizeHint) {
+    size_t bound = n > SIZE_MAX / maxRatio ? SIZE_MAX : n * maxRatio;
+    size_t size  = sizeHint != 0 ? sizeHint : n > SIZE_MAX / 4 ? SIZE_MAX : 4 * n;
+    return std::max(std::min(size, bound), minSize);
+  }
+}
+
+bool FlateDecode(uint8_t const* bytes, size_t n, size_t sizeHint, FlateOutput &out)
+{
+  z_stream strm {};
+  if (Z_OK != inflateInit(&strm)) return false;
+
+  size_t cap  = initialSize(n, sizeHint);
+  size_t used = 0;
+  char  *buf  = static_cast<char*>(std::malloc(cap));
+  if (buf == nullptr) {
+    inflateEnd(&strm);
+    return false;
+  }
+
+  // zlib counts bytes with `uInt`, so very large inputs are fed in pieces.
+  strm.next_in  = const_cast<Bytef*>(bytes);
+  size_t inLeft = n;
+
+  while (true) {
+    if (used == cap) {
+      char *bigger = static_cast<char*>(std::realloc(buf, 2 * cap));
+      if (bigger == nullptr) break;
+      buf  = bigger;
+      cap *= 2;
+    }
+
+    if (strm.avail_in == 0 && inLeft > 0) {
+      strm.avail_in = std::min<size_t>(inLeft, UINT_MAX);
+      inLeft       -= strm.avail_in;
+    }
+
+    size_t room    = std::min<size_t>(cap - used, UINT_MAX);
+    strm.next_out  = reinterpret_cast<Bytef*>(buf + used);
+    strm.avail_out = room;
+
+    int ret = inflate(&strm, inLeft == 0 ? Z_FINISH : Z_NO_FLUSH);
+    used += room - strm.avail_out;
+
+    if (ret == Z_STREAM_END) {
+      inflateEnd(&strm);
+
+      // Give back the space we did not need, if that is a lot.
+      if (used > 0 && used < cap / 2) {
+        if (char *smaller = static_cast<char*>(std::realloc(buf, used))) buf = smaller;
+      }
+      out.data = buf;
+      out.size = used;
+      return true;
+    }
+
+    if (ret != Z_OK && ret != Z_BUF_ERROR) break;
+
+    // Out of input, before the end of the stream
+    if (strm.avail_out > 0 && strm.avail_in == 0 && inLeft == 0) {
+      inflateEnd(&strm);
+      out.data = buf;
+      out.size = used;
+      return true;
+    }
+  }
+
+  inflateEnd(&strm);
+  std::free(buf);
+  return false;
+}
@@ -1,13 +1,14 @@
 #include "args.hpp"
 
 #include <getopt.h>
+#include <climits>
 #include <cstdlib>
 #include <iostream>
 
-Args::Args() : extractText(false), outputFile() {}
+Args::Args() : extractText(false), jobs(1), outputFile() {}
 
 namespace {
-    char const* const optstring = "ht";
+    char const* const optstring = "htj:";
 
     const struct option longopts[] = {
         { "text-output", required_argument, NULL, 'o'},
@@ -15,7 +16,7 @@ namespace {
     };
 
     [[noreturn]] void usage() {
-        std::cerr << "Usage: parser-test [-h] [-t] [--output-file=OUTPUTFILE] INPUTFILE" << std::endl;
+        std::cerr << "Usage: parser-test [-h] [-t] [-j JOBS] [--output-file=OUTPUTFILE] INPUTFILE" << std::endl;
         exit(EXIT_FAILURE);
     }
 }
@@ -29,6 +30,19 @@ Args parse_args(int &argc, char ** &argv)
         switch (ch) {
         case 'o': args.outputFile = optarg; break;
         case 't': args.extractText = true; break;
+        case 'j': {
+            char *end;
+            unsigned long n = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || n == 0 || n > UINT_MAX) usage();
+#ifndef PDF_PARALLEL
+            if (n > 1) {
+                std::cerr << "parser-test was built without PDF_PARALLEL, ignoring -j" << std::endl;
+                n = 1;
+            }
+#endif
+            args.jobs = n;
+            break;
+        }
         case 'h': usage();
         default: usage();
         }
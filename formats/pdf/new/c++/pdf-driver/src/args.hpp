@@ -4,6 +4,7 @@
 
 struct Args {
     bool extractText;
+    unsigned jobs;              // Objects are validated by up to this many threads
     std::string outputFile;
     std::string inputFile;
 
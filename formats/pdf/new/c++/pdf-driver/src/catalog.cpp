@@ -1,28 +1,8 @@
 #include <main_parser.h>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include "catalog.hpp"
 #include "glyphmap.h"
 
-bool inputFromFile(const char *file, DDL::Input *input)
-{
-  std::ifstream fin {file, std::ios::in | std::ios::binary};
-  std::ostringstream sout;
-
-  if (!fin.is_open()) {
-    return false;
-  }
-
-  sout << fin.rdbuf();
-  std::string str = std::move(sout.str());
-
-  *input = DDL::Input{file, str.data(), str.size()};
-  return true;
-}
-
-
-
 // XXX: Tihs is a differen format and should not need the referneces
 bool getGlyphMap(ReferenceTable &refs, const char *file, DDL::ResultOf::parseStdEncodings *out) {
 
@@ -8,5 +8,3 @@ public:
 
 void check_catalog(ReferenceTable &refs, bool text);
 
-
-bool inputFromFile(const char *file, DDL::Input *input);
@@ -6,6 +6,6 @@ struct NullBuffer : public std::streambuf {
   int overflow(int c) { return c; }
 } null_buffer;
 
-std::ostream dbg(&null_buffer);
+thread_local std::ostream dbg(&null_buffer);
 #endif
 
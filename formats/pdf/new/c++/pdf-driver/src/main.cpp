@@ -1,9 +1,15 @@
 #include <iostream>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <unordered_set>
 #include <fstream>
+#include <map>
 #include <sstream>
+#include <string>
 #include <exception>
+#include <thread>
+#include <vector>
 
 #include <fcntl.h>
 #include <sys/types.h>
@@ -11,6 +17,8 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <ddl/batch.h>
+#include <ddl/file_input.h>
 #include <ddl/input.h>
 #include <ddl/number.h>
 #include <ddl/owned.h>
@@ -52,13 +60,118 @@ void utf8(std::ostream &out, std::u32string str)
 }
 
 
+namespace {
+
+enum class Verdict { Malformed, Unsafe, Safe };
+
+// What we found when checking an object.
+struct Outcome {
+  Verdict                 verdict = Verdict::Safe;
+  std::vector<Diagnostic> diagnostics;  // Messages from resolving references
+  std::exception_ptr      error;        // If the check threw an exception
+};
+
+struct Object {
+  uint64_t        refid;
+  generation_type gen;
+};
+
+Verdict checkObject(ReferenceTable &refs, Object obj) {
+  PdfCos::Ref ref;
+  ref.init(DDL::Integer{obj.refid}, DDL::Integer{obj.gen});
+  std::vector<DDL::Bool> results;
+  DDL::ParseError<DDL::Input> error;
+  parseCheckRef(refs, error, results, DDL::Input{"",""}, ref);
+  if (results.size() != 1) {
+    for (auto && x : results) { x.free(); }
+    return Verdict::Malformed;
+  }
+  return results[0].getValue() ? Verdict::Safe : Verdict::Unsafe;
+}
+
+// Check an object, keeping the messages and exceptions that go with it.
+Outcome checkOutcome(ReferenceTable &refs, Object obj) {
+  Outcome out;
+  try {
+    out.verdict = checkObject(refs, obj);
+  } catch (...) {
+    out.error = std::current_exception();
+  }
+  out.diagnostics = refs.takeDiagnostics();
+  return out;
+}
+
+// Check the objects using the given number of threads.
+// The outcomes are in the same order as the objects.  We stop at the
+// first object whose check throws: objects after it may be checked
+// when using several threads, but they are not reported.
+// Each thread works with its own copy of `refs`, so objects resolved
+// by one thread are not shared with the others, but the input and the
+// objects resolved before the copy are.  This relies on the runtime
+// being compiled with `DDL_ATOMIC_REFCOUNT` (see `PDF_PARALLEL`).
+std::vector<Outcome>
+checkObjects(ReferenceTable &refs, std::vector<Object> const& objs, unsigned jobs) {
+  std::vector<Outcome> outcomes(objs.size());
+
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  jobs = std::min<size_t>({jobs, cores, objs.size()});
+
+  if (jobs <= 1) {
+    for (size_t i = 0; i < objs.size(); ++i) {
+      outcomes[i] = checkOutcome(refs, objs[i]);
+      if (outcomes[i].error) break;
+    }
+    return outcomes;
+  }
+
+  DDL::BatchQueues queues(jobs, objs.size());
+  std::vector<std::thread> threads;
+  std::atomic<size_t> firstError = objs.size();
+
+  for (unsigned w = 0; w < jobs; ++w) {
+    threads.emplace_back([&, w, local = refs]() mutable {
+      size_t i;
+      while (queues.next(w, i)) {
+        if (i > firstError.load()) continue;
+        outcomes[i] = checkOutcome(local, objs[i]);
+        if (!outcomes[i].error) continue;
+        size_t e = firstError.load();
+        while (i < e && !firstError.compare_exchange_weak(e, i)) {}
+      }
+    });
+  }
+  for (auto &t : threads) t.join();
+
+  return outcomes;
+}
+
+// The first message about each object, by object id.
+// With several threads, a broken object may be resolved by more than one
+// of them, while checking different objects, so we keep the messages
+// with the object they are about rather than the one being checked, and
+// report each only once.  Then the output does not depend on the number
+// of threads, or on which thread got to an object first.
+std::map<uint64_t, std::string>
+collectDiagnostics(std::vector<Outcome> const& outcomes) {
+  std::map<uint64_t, std::string> msgs;
+  for (auto const& out : outcomes)
+    for (auto const& d : out.diagnostics) msgs.emplace(d.refid, d.msg);
+  return msgs;
+}
+
+void printDiagnostics(std::vector<Diagnostic> const& ds) {
+  for (auto const& d : ds) std::cerr << d.msg;
+}
+
+}
 
 int main(int argc, char* argv[]) {
 
   auto args = parse_args(argc, argv);
 
   DDL::Input input;
-  if (!inputFromFile(args.inputFile.c_str(), &input)) {
+  if (!DDL::inputFromFile(args.inputFile.c_str(), &input,
+                          DDL::InputAccess::Random)) {
     std::cerr << "Unable to open file" << std::endl;
     return 1;
   }
@@ -73,6 +186,7 @@ int main(int argc, char* argv[]) {
   try {
     refs.process_pdf(input);
     check_catalog(refs, text);
+    printDiagnostics(refs.takeDiagnostics());
     if (text) {
       if (args.outputFile.empty()) {
         utf8(std::cout, emittedCodepoints);
@@ -85,27 +199,37 @@ int main(int argc, char* argv[]) {
       return 0;
     }
 
-    for (auto && [refid, val] : refs.table) {
-      PdfCos::Ref ref;
-      ref.init(DDL::Integer{refid}, DDL::Integer{val.gen});
-      std::vector<DDL::Bool> results;
-      DDL::ParseError<DDL::Input> error;
-      parseCheckRef(refs, error, results, DDL::Input{"",""}, ref);
-      if (results.size() != 1) {
-        std::cerr << "ERROR: [" << refid << "," << val.gen << "] Malformed\n";
-        reject = true;
-      } else {
-        safe &= results[0].getValue();
-        if (!results[0].getValue())
-          std::cerr << "INFO: [" << refid << "," << val.gen << "] is unsafe\n";
+    std::vector<Object> objs;
+    for (auto && [refid, val] : refs.table) objs.push_back(Object{refid, val.gen});
+
+    auto outcomes = checkObjects(refs, objs, args.jobs);
+    auto msgs     = collectDiagnostics(outcomes);
+    for (size_t i = 0; i < objs.size(); ++i) {
+      auto [refid, gen] = objs[i];
+      Outcome const& out = outcomes[i];
+      if (auto m = msgs.find(refid); m != msgs.end()) std::cerr << m->second;
+      if (out.error) std::rethrow_exception(out.error);
+      switch (out.verdict) {
+        case Verdict::Malformed:
+          std::cerr << "ERROR: [" << refid << "," << gen << "] Malformed\n";
+          reject = true;
+          break;
+        case Verdict::Unsafe:
+          std::cerr << "INFO: [" << refid << "," << gen << "] is unsafe\n";
+          safe = false;
+          break;
+        case Verdict::Safe:
+          break;
       }
     }
 
   } catch (XrefException const& e) {
+    printDiagnostics(refs.takeDiagnostics());
     std::cerr << "ERROR: [XRef] " << e.what() << std::endl;
     reject = true;
 
   } catch (CatalogException const& e) {
+    printDiagnostics(refs.takeDiagnostics());
     std::cerr << "ERROR: [Catalog] " << e.what() << std::endl;
     reject = true;
   }
@@ -6,6 +6,6 @@
 #ifdef DEBUG
 #define dbg std::cerr
 #else
-extern std::ostream dbg;
+extern thread_local std::ostream dbg;
 
 #endif
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <list>
 #include <map>
+#include <string>
 #include <tuple>
+#include <vector>
 #include <variant>
+#include <unordered_map>
 #include <unordered_set>
 #include <optional>
 
@@ -45,12 +49,109 @@ using oref = std::variant<
 
 using generation_type = uint16_t;
 
+// A message about an object that we could not resolve.
+struct Diagnostic {
+    uint64_t refid;             // The object the message is about
+    std::string msg;
+};
+
 struct ReferenceEntry {
     ReferenceEntry(oref value, generation_type gen);
     oref value;
     generation_type gen;
 };
 
+// The entries of a reference table, indexed by object id.
+// Object ids are usually dense, so we keep the entries in a vector
+// indexed by id.  Ids that are much larger than the number of entries
+// go in a map instead, so that a few large ids do not make us allocate
+// a huge vector.  All ids in `sparse` are at least `dense.size()`.
+class ReferenceEntries {
+    std::vector<std::optional<ReferenceEntry>> dense;
+    std::map<uint64_t, ReferenceEntry> sparse;
+    size_t count;
+
+    // Make the vector large enough for `refid`, if it is dense enough.
+    void grow(uint64_t refid);
+
+public:
+    ReferenceEntries();
+
+    // Borrowed result, nullptr if there is no entry for `refid`.
+    // Valid until the next insertion.
+    ReferenceEntry *find(uint64_t refid);
+
+    void insert_or_assign(uint64_t refid, ReferenceEntry entry);
+    void erase(uint64_t refid);
+    size_t size() const;
+
+    // Iterates over the entries in order of their ids.
+    class iterator {
+        ReferenceEntries *entries;
+        size_t i;                                       // index in `dense`
+        std::map<uint64_t, ReferenceEntry>::iterator s; // used when `i` is past `dense`
+
+        void skip() {
+            while (i < entries->dense.size() && !entries->dense[i]) ++i;
+        }
+
+    public:
+        iterator(ReferenceEntries *entries, size_t i,
+                 std::map<uint64_t, ReferenceEntry>::iterator s)
+        : entries(entries), i(i), s(s) { skip(); }
+
+        std::pair<uint64_t, ReferenceEntry&> operator*() const {
+            if (i < entries->dense.size()) return {i, *entries->dense[i]};
+            return {s->first, s->second};
+        }
+
+        iterator &operator++() {
+            if (i < entries->dense.size()) { ++i; skip(); } else ++s;
+            return *this;
+        }
+
+        bool operator==(iterator const &other) const { return i == other.i && s == other.s; }
+        bool operator!=(iterator const &other) const { return !(*this == other); }
+    };
+
+    iterator begin();
+    iterator end();
+};
+
+
+// Decoded object streams, keyed by the id of their container, so that
+// resolving all the objects in a stream only decodes it once.
+// When the decoded data takes more than `limit` bytes, we evict the
+// least recently used streams.
+class ObjStreamCache {
+    struct Entry {
+        DDL::Owned<PdfCos::ObjStream> stream;
+        size_t bytes;
+        std::list<uint64_t>::iterator use;
+    };
+
+    std::unordered_map<uint64_t, Entry> entries;
+    std::list<uint64_t> uses;   // most recently used first
+    size_t bytes;
+    size_t limit;
+
+public:
+    explicit ObjStreamCache(size_t limit = 64 * 1024 * 1024);
+
+    // A copy has the same limit, but starts empty.
+    ObjStreamCache(ObjStreamCache const &other);
+    ObjStreamCache &operator=(ObjStreamCache const &) = delete;
+
+    // Populates owned result
+    // Returns true if the stream was in the cache
+    bool lookup(uint64_t container, PdfCos::ObjStream *result);
+
+    // Borrows stream
+    void insert(uint64_t container, PdfCos::ObjStream stream);
+
+    // Bytes used by the cached streams
+    size_t size() const;
+};
 
 class ReferenceTable {
 
@@ -58,6 +159,8 @@ private:
     std::optional<DDL::Owned<DDL::Input>> topinput;
     std::optional<EncryptionContext> encCtx;
     std::optional<DDL::Owned<PdfCos::Ref>> root;
+    ObjStreamCache objStreams;
+    std::vector<Diagnostic> diagnostics;
 
     void process_xref(std::unordered_set<size_t>*, DDL::Input, DDL::Size, bool top);
     void process_oldXRef(std::unordered_set<size_t>*, DDL::Input, PdfCos::CrossRefAndTrailer, bool top);
@@ -70,7 +173,7 @@ private:
     void unregister(uint64_t refid);
 
 public: // temporarily public member
-    std::map<uint64_t, ReferenceEntry> table;
+    ReferenceEntries table;
 
     uint64_t currentObjId;
     generation_type currentGen;
@@ -80,7 +183,19 @@ public:
 
     bool resolve_reference(uint64_t refid, generation_type gen, DDL::Maybe<PdfCos::TopDecl> *result);
 
+    // Populates owned result
+    // Returns true on success
+    bool resolve_objstream(uint64_t container, PdfCos::ObjStream *result);
+
     std::optional<DDL::Owned<PdfCos::Ref>> const& getRoot() const;
+
+    // Record a message about a problem found while resolving the current
+    // object.  Messages are not printed, so that when objects are checked
+    // in parallel the driver can report them in object order.
+    void diagnose(std::string const& msg);
+
+    // Returns the messages recorded since the last call, and forgets them
+    std::vector<Diagnostic> takeDiagnostics();
     
     // owns input
     void process_pdf(DDL::Input);
@@ -1,12 +1,12 @@
 #include <iostream>
 #include <cctype>
+#include <cstdlib>
 #include <iomanip>
 #include <openssl/evp.h>
 
-#include <zlib.h>
-
 #include "asciihex.hpp"
 #include "ascii85.hpp"
+#include "flate.hpp"
 #include "lzw.hpp"
 #include "predictor.hpp"
 
@@ -144,6 +144,11 @@ bool parser_Decrypt
   }
 }
 
+namespace {
+  // Releases the bytes of inputs made from `malloc`ed buffers
+  void releaseMalloced(void *buf, DDL::UInt<8> *, DDL::Size) { std::free(buf); }
+}
+
 // owns input, predictor, colors, bpc, columns, body
 bool parser_FlateDecode
   ( DDL::ParserStateUser<DDL::Input,ReferenceTable> &pstate
@@ -164,48 +169,28 @@ bool parser_FlateDecode
     auto columnsOwned = DDL::Owned(columns);
     auto bodyRef = DDL::Owned(body);
 
-    std::string buffer;
-
-    z_stream strm;
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
-    strm.avail_in = body.length().value;
-    strm.next_in = const_cast<unsigned char *>(reinterpret_cast<unsigned char const *>(bodyRef->borrowBytes().data()));
-    
-    if (Z_OK != inflateInit(&strm)) {
-      std::cerr << "INFO: inflate failed Z NOT OK" << std::endl;
+    FlateOutput output;
+    if (!FlateDecode(
+          reinterpret_cast<uint8_t const*>(bodyRef->borrowBytes().data()),
+          bodyRef->length().value,
+          0,
+          output))
+    {
+      std::cerr << "INFO: inflate failed" << std::endl;
       input.free();
       return false;
     }
 
-    size_t const chunksize = 2048;
-
-    do {
-      size_t used = buffer.size();
-      buffer.resize(used + chunksize);
-
-      strm.avail_out = chunksize;
-      strm.next_out = reinterpret_cast<unsigned char*>(&buffer[used]);
-
-      int ret = inflate(&strm, Z_FINISH);
-
-      switch (ret) {
-        case Z_NEED_DICT:
-        case Z_DATA_ERROR:
-        case Z_MEM_ERROR:
-          inflateEnd(&strm);
-          input.free();
-          std::cerr << "INFO: inflate failed" << std::endl;
-          return false;
-      }
-
-      if (strm.avail_out > 0) {
-        buffer.resize(used + (chunksize - strm.avail_out));
-      }
-    } while (strm.avail_out == 0);
+    // Without a predictor, the input takes over the buffer.
+    if (predictor.asSize().value == 1) {
+      *result = DDL::Input("inflated", output.data, DDL::Size(output.size),
+                           releaseMalloced, output.data);
+      *out_input = input;
+      return true;
+    }
 
-    inflateEnd(&strm);
+    std::string buffer(output.data, output.size);
+    std::free(output.data);
 
     if (!unpredict(
         predictor.asSize().value,
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <cstring>
+#include <sstream>
 #include <vector>
 
 #include <ddl/utils.h>
@@ -12,6 +13,74 @@ template<class> inline constexpr bool always_false_v = false;
 ReferenceEntry::ReferenceEntry(oref value, generation_type gen)
 : value(value), gen(gen) {}
 
+ReferenceEntries::ReferenceEntries() : count(0) {}
+
+ReferenceEntry *
+ReferenceEntries::find(uint64_t refid)
+{
+    if (refid < dense.size()) {
+        auto &entry = dense[refid];
+        return entry ? &*entry : nullptr;
+    }
+
+    auto cursor = sparse.find(refid);
+    return cursor == std::end(sparse) ? nullptr : &cursor->second;
+}
+
+void
+ReferenceEntries::grow(uint64_t refid)
+{
+    // Keep the vector at least half full, allowing some slack for
+    // small documents.
+    uint64_t limit = 2 * (count + 1) + 1024;
+    if (refid >= limit) return;
+
+    size_t n = std::min<uint64_t>(std::max<uint64_t>(refid + 1, 2 * dense.size()), limit);
+    dense.resize(n);
+
+    // Move the entries that now fit in the vector
+    auto cursor = std::begin(sparse);
+    while (cursor != std::end(sparse) && cursor->first < n) {
+        dense[cursor->first].emplace(std::move(cursor->second));
+        cursor = sparse.erase(cursor);
+    }
+}
+
+void
+ReferenceEntries::insert_or_assign(uint64_t refid, ReferenceEntry entry)
+{
+    if (refid >= dense.size()) grow(refid);
+
+    if (refid < dense.size()) {
+        auto &slot = dense[refid];
+        if (!slot) ++count;
+        slot = std::move(entry);
+        return;
+    }
+
+    if (sparse.insert_or_assign(refid, std::move(entry)).second) ++count;
+}
+
+void
+ReferenceEntries::erase(uint64_t refid)
+{
+    if (refid < dense.size()) {
+        auto &slot = dense[refid];
+        if (slot) { slot.reset(); --count; }
+        return;
+    }
+    count -= sparse.erase(refid);
+}
+
+size_t
+ReferenceEntries::size() const { return count; }
+
+ReferenceEntries::iterator
+ReferenceEntries::begin() { return iterator(this, 0, std::begin(sparse)); }
+
+ReferenceEntries::iterator
+ReferenceEntries::end() { return iterator(this, dense.size(), std::end(sparse)); }
+
 TopThunk::TopThunk(uint64_t offset) : offset(offset) {}
 
 // Owns input
@@ -35,7 +104,9 @@ TopThunk::getDecl(ReferenceTable &refs, DDL::Input input, PdfCos::TopDecl *resul
 
     if (results.size() != 1) {
         for (auto &&x : results) { x.free(); }
-        std::cerr << "ERROR: PARSE ERROR\n" << error << std::endl;
+        std::ostringstream msg;
+        msg << "ERROR: PARSE ERROR\n" << error << "\n";
+        refs.diagnose(msg.str());
         input.free();
         return false;
     }
@@ -56,34 +127,55 @@ StreamThunk::StreamThunk(uint64_t container, uint64_t index)
 bool
 StreamThunk::getDecl(ReferenceTable &refs, uint64_t refid, PdfCos::TopDecl *result)
 {
-    DDL::Maybe<PdfCos::TopDecl> streamResult;
-    if (!refs.resolve_reference(container, 0, &streamResult)) {
-        return false;
-    }
+    PdfCos::ObjStream objStream;
+    if (!refs.resolve_objstream(container, &objStream)) return false;
 
-    if (streamResult.isNothing()) {
-        return false;
-    }
+    DDL::ParseError<DDL::Input> error;
+    return DDL::parseOneUser(parseObjStreamEntry, refs, error, result,
+                  DDL::Input("",""), objStream, DDL::UInt<64>(index));
+}
 
-    if (DDL::Tag::TopDeclDef::stream != streamResult.borrowValue().borrow_obj().getTag()) {
-        streamResult.free();
-        return false;
-    }
+ObjStreamCache::ObjStreamCache(size_t limit) : bytes(0), limit(limit) {}
 
-    auto stream = streamResult.borrowValue().borrow_obj().get_stream();
-    streamResult.free();
+ObjStreamCache::ObjStreamCache(ObjStreamCache const &other)
+: bytes(0), limit(other.limit) {}
 
-    // XXX: Maybe we should cache the parsed ObjStreams so we don't
-    // have to reparse them for every object?
-    DDL::ParseError<DDL::Input> error;
-    PdfCos::ObjStream objStream;
-    if (!DDL::parseOneUser(parseObjStream, refs, error, &objStream,
-       DDL::Input("ObjStream", ""), stream)) return false;
+bool
+ObjStreamCache::lookup(uint64_t container, PdfCos::ObjStream *result)
+{
+    auto cursor = entries.find(container);
+    if (cursor == std::end(entries)) return false;
 
-    return DDL::parseOneUser(parseObjStreamEntry, refs, error, result,
-                  DDL::Input("",""), objStream, DDL::UInt<64>(index));
+    uses.splice(std::begin(uses), uses, cursor->second.use);
+    *result = cursor->second.stream.get();
+    return true;
+}
+
+void
+ObjStreamCache::insert(uint64_t container, PdfCos::ObjStream stream)
+{
+    // The decoded bytes, and the offset table
+    size_t n = stream.borrow_bytes().length().value
+             + stream.borrow_index().size().value * sizeof(PdfCos::ObjStreamMeta);
+
+    // A stream that does not fit is not worth evicting everything else for.
+    if (n > limit || entries.count(container) != 0) return;
+
+    while (bytes + n > limit) {
+        auto victim = entries.find(uses.back());
+        bytes -= victim->second.bytes;
+        entries.erase(victim);
+        uses.pop_back();
+    }
+
+    uses.push_front(container);
+    entries.emplace(container, Entry{DDL::borrowed(stream), n, std::begin(uses)});
+    bytes += n;
 }
 
+size_t
+ObjStreamCache::size() const { return bytes; }
+
 // Owns topDecl
 void
 ReferenceTable::register_topdecl(uint64_t refid, generation_type gen, PdfCos::TopDecl topDecl)
@@ -142,19 +234,27 @@ bool
 ReferenceTable::resolve_reference(
     uint64_t refid, generation_type gen, DDL::Maybe<PdfCos::TopDecl> *result
 ) {
-    auto cursor = table.find(refid);
+    ReferenceEntry *entry = table.find(refid);
 
-    if (cursor == std::end(table) || cursor->second.gen != gen) {
+    if (entry == nullptr || entry->gen != gen) {
         *result = DDL::Maybe<PdfCos::TopDecl>();
         return true;
     }
 
-    // Copy the entry by value so that we can replace it with a blackhole if needed
-    auto entry = cursor->second.value;
+    dbg << "Resolving reference " << refid << " with thunk type " << entry->value.index() << std::endl;
 
-    dbg << "Resolving reference " << refid << " with thunk type " << entry.index() << std::endl;
+    // Thunks are copied out of the entry before we replace it with a
+    // blackhole.  Resolving them may resolve other references, so we
+    // look up the entry again to store the result.
+    auto finish = [refid, this, result](bool success, PdfCos::TopDecl decl) {
+        if (success) {
+            if (ReferenceEntry *e = table.find(refid)) e->value = borrowed(decl);
+            *result = decl;
+        }
+        return success;
+    };
 
-    return std::visit([refid, gen, this, cursor, result](auto&& arg) -> bool {
+    return std::visit([refid, gen, this, entry, result, &finish](auto& arg) -> bool {
         using T = std::decay_t<decltype(arg)>;
         if constexpr (std::is_same_v<T, DDL::Owned<PdfCos::TopDecl>>) {
             *result = arg.get();
@@ -163,28 +263,54 @@ ReferenceTable::resolve_reference(
             return false;
         } else if constexpr (std::is_same_v<T, TopThunk>) {
             ReferenceContext refCon{*this, refid, gen};
-            cursor->second.value = Blackhole();
+            TopThunk thunk = arg;
+            entry->value = Blackhole();
             PdfCos::TopDecl decl{};
-            bool success = arg.getDecl(*this, topinput->get(), &decl);
-            if (success) {
-                cursor->second.value = borrowed(decl);
-                *result = decl;
-            }
-            return success;
+            bool success = thunk.getDecl(*this, topinput->get(), &decl);
+            return finish(success, decl);
         } else if constexpr (std::is_same_v<T, StreamThunk>) {
             ReferenceContext refCon{*this, refid, gen};
-            cursor->second.value = Blackhole();
+            StreamThunk thunk = arg;
+            entry->value = Blackhole();
             PdfCos::TopDecl decl{};
-            bool success = arg.getDecl(*this, refid, &decl);
-            if (success) {
-                cursor->second.value = borrowed(decl);
-                *result = decl;
-            }
-            return success;
+            bool success = thunk.getDecl(*this, refid, &decl);
+            return finish(success, decl);
         } else {
             static_assert(always_false_v<T>, "non-exhaustive visitor!");
         }
-    }, entry);
+    }, entry->value);
+}
+
+// Populates owned result
+// Returns true on success
+bool
+ReferenceTable::resolve_objstream(uint64_t container, PdfCos::ObjStream *result)
+{
+    if (objStreams.lookup(container, result)) return true;
+
+    DDL::Maybe<PdfCos::TopDecl> streamResult;
+    if (!resolve_reference(container, 0, &streamResult)) {
+        return false;
+    }
+
+    if (streamResult.isNothing()) {
+        return false;
+    }
+
+    if (DDL::Tag::TopDeclDef::stream != streamResult.borrowValue().borrow_obj().getTag()) {
+        streamResult.free();
+        return false;
+    }
+
+    auto stream = streamResult.borrowValue().borrow_obj().get_stream();
+    streamResult.free();
+
+    DDL::ParseError<DDL::Input> error;
+    if (!DDL::parseOneUser(parseObjStream, *this, error, result,
+       DDL::Input("ObjStream", ""), stream)) return false;
+
+    objStreams.insert(container, *result);
+    return true;
 }
 
 namespace {
@@ -364,6 +490,20 @@ ReferenceTable::getEncryptionContext() const
 std::optional<DDL::Owned<PdfCos::Ref>> const&
 ReferenceTable::getRoot() const { return root; }
 
+void
+ReferenceTable::diagnose(std::string const& msg)
+{
+    diagnostics.push_back(Diagnostic{currentObjId, msg});
+}
+
+std::vector<Diagnostic>
+ReferenceTable::takeDiagnostics()
+{
+    std::vector<Diagnostic> result;
+    result.swap(diagnostics);
+    return result;
+}
+
 
 // Borrows input
 void ReferenceTable::process_xref(std::unordered_set<size_t> *visited, DDL::Input input, DDL::Size offset, bool top)
@@ -0,0 +1,24 @@
+# Checks that parser-test reports the same thing with one and with
+# several threads.
+#
+# Usage: cmake -DPARSER_TEST=... -DINPUT=... -P compare_jobs.cmake
+
+foreach(jobs 1 4)
+  execute_process(
+    COMMAND ${PARSER_TEST} -j ${jobs} ${INPUT}
+    OUTPUT_VARIABLE out_${jobs}
+    ERROR_VARIABLE  out_${jobs}
+    RESULT_VARIABLE res_${jobs}
+  )
+endforeach()
+
+if(NOT res_1 EQUAL res_4 OR NOT out_1 STREQUAL out_4)
+  message(FATAL_ERROR
+    "-j 1 exited with ${res_1}:\n${out_1}\n-j 4 exited with ${res_4}:\n${out_4}")
+endif()
+
+string(REGEX MATCHALL "PARSE ERROR" errors "${out_1}")
+list(LENGTH errors count)
+if(count GREATER 1)
+  message(FATAL_ERROR "parse error reported ${count} times:\n${out_1}")
+endif()
@@ -0,0 +1,139 @@
+// Compares `FlateDecode` with inflating in fixed 2048 byte steps into a
+// `std::string`, followed by a copy, which is what the pdf parser used
+// to do.
+//
+// Usage: flate-bench FILE...
+//
+// The corpus is made of the Flate streams found in the given files
+// (e.g., PDF files): we try to inflate everything between `stream`
+// and `endstream`.  A file that is a zlib stream by itself is used whole.
+
+#include "flate.hpp"
+
+#include <zlib.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+bool oldInflate(std::string_view in, std::string &copy) {
+  std::string buffer;
+  z_stream strm {};
+  strm.avail_in = in.size();
+  strm.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  if (Z_OK != inflateInit(&strm)) return false;
+
+  size_t const chunksize = 2048;
+  do {
+    size_t used = buffer.size();
+    buffer.resize(used + chunksize);
+    strm.avail_out = chunksize;
+    strm.next_out  = reinterpret_cast<Bytef*>(&buffer[used]);
+    int ret = inflate(&strm, Z_FINISH);
+    if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
+      inflateEnd(&strm);
+      return false;
+    }
+    if (strm.avail_out > 0) buffer.resize(used + (chunksize - strm.avail_out));
+  } while (strm.avail_out == 0);
+  inflateEnd(&strm);
+
+  copy = buffer;    // the copy made by `DDL::Input`
+  return true;
+}
+
+bool newInflate(std::string_view in, size_t &size) {
+  FlateOutput out;
+  if (!FlateDecode(reinterpret_cast<uint8_t const*>(in.data()), in.size(), 0, out))
+    return false;
+  size = out.size;
+  std::free(out.data);
+  return true;
+}
+
+void addStreams(std::string const &file, std::vector<std::string_view> &corpus) {
+  std::string_view s = file;
+  size_t end = 0;
+  while (true) {
+    size_t start = s.find("stream", end);
+    if (start == std::string_view::npos) break;
+    start += 6;
+    if (s.substr(start, 2) == "\r\n") start += 2;
+    else if (s.substr(start, 1) == "\n") start += 1;
+    else { end = start; continue; }
+    end = s.find("endstream", start);
+    if (end == std::string_view::npos) break;
+    size_t ignored;
+    std::string_view body = s.substr(start, end - start);
+    if (newInflate(body, ignored)) corpus.push_back(body);
+  }
+}
+
+template <typename F>
+double seconds(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+  return t.count();
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: flate-bench FILE..." << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> files;
+  std::vector<std::string_view> corpus;
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream fin {argv[i], std::ios::in | std::ios::binary};
+    files.emplace_back(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+  }
+  for (auto &f : files) {
+    size_t ignored;
+    if (newInflate(f, ignored)) corpus.push_back(f);
+    else addStreams(f, corpus);
+  }
+
+  size_t in = 0, out = 0;
+  for (auto s : corpus) {
+    std::string copy;
+    oldInflate(s, copy);
+    in  += s.size();
+    out += copy.size();
+  }
+  if (out == 0) {
+    std::cerr << "No Flate streams found" << std::endl;
+    return 1;
+  }
+
+  size_t const reps = std::max<size_t>(1, (256u << 20) / out);
+  size_t checkOld = 0, checkNew = 0;
+
+  double tOld = seconds([&]() {
+    for (size_t r = 0; r < reps; ++r)
+      for (auto s : corpus) { std::string copy; oldInflate(s, copy); checkOld += copy.size(); }
+  });
+  double tNew = seconds([&]() {
+    for (size_t r = 0; r < reps; ++r)
+      for (auto s : corpus) { size_t n = 0; newInflate(s, n); checkNew += n; }
+  });
+  if (checkOld != checkNew) std::cerr << "Outputs differ in size" << std::endl;
+
+  double mb = double(out) * reps / (1 << 20);
+  std::cout << corpus.size() << " streams, " << in << " bytes in, "
+            << out << " bytes out\n"
+            << "2048 byte steps + copy: " << mb / tOld << " MB/s\n"
+            << "FlateDecode:            " << mb / tNew << " MB/s\n";
+  return 0;
+}
@@ -1,31 +1,12 @@
 #include <iostream>
-#include <sstream>
-#include <fstream>
 
 #include <ddl/input.h>
+#include <ddl/file_input.h>
 #include <ddl/number.h>
 #include <ddl/utils.h>
 
 #include "build/ddl/example1/main_parser.h"
 
-// Create a Deadlus input from a file
-bool inputFromFile(const char *file, DDL::Input *input)
-{
-  std::ifstream fin {file, std::ios::in | std::ios::binary};
-  std::ostringstream sout;
-
-  if (!fin.is_open()) {
-    return false;
-  }
-
-  sout << fin.rdbuf();
-  std::string str = std::move(sout.str());
-
-  *input = DDL::Input{file, str.data(), str.size()};
-  return true;
-}
-
-
 int main(int argc, char *argv[]) {
 
   for (size_t count = 1; count < argc; ++count) {
@@ -33,7 +14,7 @@ int main(int argc, char *argv[]) {
 
     // Load packet bytes from a file
     DDL::Input input;
-    if (!inputFromFile(argv[count], &input)) {
+    if (!DDL::inputFromFile(argv[count], &input)) {
       std::cerr << "Failed to open file " << argv[count] << std::endl;
       return 1;
     }
@@ -1,31 +1,13 @@
 #include <iostream>
-#include <sstream>
-#include <fstream>
 
 #include <ddl/input.h>
+#include <ddl/file_input.h>
 #include <ddl/number.h>
 #include <ddl/unit.h>
 #include <ddl/utils.h>
 
 #include "build/ddl/example2/main_parser.h"
 
-// Create a Deadlus input from a file
-bool inputFromFile(const char *file, DDL::Input *input)
-{
-  std::ifstream fin {file, std::ios::in | std::ios::binary};
-  std::ostringstream sout;
-
-  if (!fin.is_open()) {
-    return false;
-  }
-
-  sout << fin.rdbuf();
-  std::string str = std::move(sout.str());
-
-  *input = DDL::Input{file, str.data(), str.size()};
-  return true;
-}
-
 // For simplicty we keep these as globals.
 // The "proper" way to do this would be to use custom user defined state.
 // See `example3` for how to do that.
@@ -54,7 +36,7 @@ bool parser_GetPacketBytes
 
   char *name = global_state.files[global_state.next_file];
   // Load packet bytes from a file
-  if (!inputFromFile(name, newInput)) {
+  if (!DDL::inputFromFile(name, newInput)) {
     std::cerr << "Failed to open file " << name << std::endl;
     return false; // We also fail if we failed to open the file
   }
@@ -1,8 +1,7 @@
 #include <iostream>
-#include <sstream>
-#include <fstream>
 
 #include <ddl/input.h>
+#include <ddl/file_input.h>
 #include <ddl/number.h>
 #include <ddl/unit.h>
 #include <ddl/utils.h>
@@ -10,23 +9,6 @@
 #include "build/ddl/example3/main_parser.h"
 #include "example3-driver.h"
 
-// Create a Deadlus input from a file
-bool inputFromFile(const char *file, DDL::Input *input)
-{
-  std::ifstream fin {file, std::ios::in | std::ios::binary};
-  std::ostringstream sout;
-
-  if (!fin.is_open()) {
-    return false;
-  }
-
-  sout << fin.rdbuf();
-  std::string str = std::move(sout.str());
-
-  *input = DDL::Input{file, str.data(), str.size()};
-  return true;
-}
-
 // This is the implementation of the `GetPacketBytes` primitive.
 bool parser_GetPacketBytes
   ( DDL::ParserStateUser<DDL::Input,CustomState>& state
@@ -47,7 +29,7 @@ bool parser_GetPacketBytes
 
   char *name = user.files[user.next_file];
   // Load packet bytes from a file
-  if (!inputFromFile(name, newInput)) {
+  if (!DDL::inputFromFile(name, newInput)) {
     std::cerr << "Failed to open file " << name << std::endl;
     return false; // We also fail if we failed to open the file
   }
@@ -0,0 +1,91 @@
+// Throughput of `DDL::parseBatch` for different numbers of workers.
+//
+// Usage: batch-bench [MESSAGES] [MESSAGE_SIZE] [MAX_WORKERS]
+//
+// The "parser" is hand written in the style of a generated entry point:
+// it walks over the input one byte at a time, pushing and popping a stack
+// frame per field, and produces the checksum of the message.
+
+#include <ddl/batch.h>
+#include <ddl/input.h>
+#include <ddl/number.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using Sum   = DDL::UInt<64>;
+using State = DDL::ParserState<DDL::Input>;
+
+namespace {
+
+struct Field : public DDL::Closure {
+  Field() : DDL::Closure(nullptr) {}
+  void freeMembers() {}
+};
+
+void parseMessage(State &p, DDL::ParseError<DDL::Input> &error,
+                  DDL::ResultSink<Sum> &results, DDL::Input i) {
+  p.reset();
+  uint64_t sum = 0;
+  while (i.length().rep() > 0) {
+    p.push(p.alloc<Field>());
+    sum = sum * 31 + i.iHead().rep();
+    i.iDropMut(DDL::Size{1});
+    p.pop()->free();
+  }
+  i.free();
+  if (sum == 0) error = p.getParseError();
+  else results.push(Sum(sum));
+}
+
+std::vector<DDL::Input> makeInputs(std::vector<std::string> const &msgs) {
+  std::vector<DDL::Input> inputs;
+  inputs.reserve(msgs.size());
+  for (auto const &m : msgs)
+    inputs.push_back(DDL::Input("msg", m.data(), DDL::Size::from(m.size()),
+                                nullptr, nullptr));
+  return inputs;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  size_t const n    = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  size_t const size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 60;
+
+  std::vector<std::string> msgs(n);
+  for (size_t i = 0; i < n; ++i) {
+    msgs[i].resize(size);
+    for (size_t j = 0; j < size; ++j) msgs[i][j] = char('a' + (i + j) % 26);
+  }
+
+  size_t const hw = argc > 3 ? std::strtoull(argv[3], nullptr, 10)
+                  : std::max(1u, std::thread::hardware_concurrency());
+  std::vector<size_t> counts;
+  for (size_t w = 1; w < hw; w *= 2) counts.push_back(w);
+  counts.push_back(hw);
+
+  double base = 0;
+  std::cout << "workers  msgs/s       speedup\n";
+  for (size_t workers : counts) {
+    DDL::BatchConfig config;
+    config.workers = workers;
+    size_t ok = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    DDL::parseBatch(parseMessage, makeInputs(msgs),
+      [&](size_t, Sum *result, DDL::ParseError<DDL::Input> const&) {
+        if (result != nullptr) ++ok;
+      }, config);
+    std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+
+    double rate = n / t.count();
+    if (workers == 1) base = rate;
+    std::cout << workers << "\t " << size_t(rate) << "\t" << rate / base << "\n";
+    if (ok != n) { std::cerr << "unexpected failures\n"; return 1; }
+  }
+  return 0;
+}
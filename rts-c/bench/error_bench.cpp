@@ -0,0 +1,99 @@
+// Cost of error tracking in the parser state: compares the default
+// `TrackErrors` policy with `NoErrorTracking` (`--no-error-tracking`).
+//
+// Usage: error-bench [MESSAGES] [MESSAGE_SIZE] [ALTERNATIVES]
+//
+// The "parser" is hand written in the style of a generated entry point:
+// for every byte it calls a function (a stack frame and a grammar context),
+// tries some alternatives that fail (each one reporting an error at the
+// current position, with a literal message), and then consumes the byte.
+// Each failure is further into the input than the previous ones, so with
+// error tracking every one of them replaces the best error so far.
+
+#include <ddl/input.h>
+#include <ddl/number.h>
+#include <ddl/parser.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Field : public DDL::Closure {
+  Field() : DDL::Closure(nullptr) {}
+  void freeMembers() {}
+};
+
+DDL::Array<DDL::UInt<8>> const message =
+  DDL::Array<DDL::UInt<8>>::literal(
+    reinterpret_cast<DDL::UInt<8> const*>("unexpected byte"), 15);
+
+// Returns a checksum of the bytes, so the work is not optimized away.
+template <typename State>
+uint64_t parseMessage(State &p, DDL::Input i, size_t alternatives) {
+  p.reset();
+  uint64_t sum = 0;
+  while (i.length().rep() > 0) {
+    p.push(p.template alloc<Field>());
+    p.pushDebug("Field");
+    for (size_t k = 0; k < alternatives; ++k)
+      p.noteFail(false, "Bench.ddl:1:1--1:5", i, message);
+    sum = sum * 31 + i.iHead().rep();
+    i.iDropMut(DDL::Size{1});
+    p.popDebug();
+    p.pop()->free();
+  }
+  i.free();
+  return sum;
+}
+
+// Returns nanoseconds per byte.
+template <typename State>
+double run(std::vector<std::string> const &msgs, size_t alternatives,
+           uint64_t &check) {
+  State p;
+  size_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (auto const &m : msgs) {
+    DDL::Input i("msg", m.data(), DDL::Size::from(m.size()), nullptr, nullptr);
+    check += parseMessage(p, i, alternatives);
+    bytes += m.size();
+  }
+  std::chrono::duration<double, std::nano> t =
+    std::chrono::steady_clock::now() - start;
+  return t.count() / bytes;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  size_t const n    = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+  size_t const size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+  size_t const alts = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 3;
+
+  std::vector<std::string> msgs(n);
+  for (size_t i = 0; i < n; ++i) {
+    msgs[i].resize(size);
+    for (size_t j = 0; j < size; ++j) msgs[i][j] = char('a' + (i + j) % 26);
+  }
+
+  using Tracking = DDL::ParserState<DDL::Input>;
+  using Silent   = DDL::ParserState<DDL::Input, DDL::ListStack,
+                                    DDL::NoErrorTracking>;
+
+  uint64_t check1 = 0, check2 = 0;
+  double track  = run<Tracking>(msgs, alts, check1);
+  double silent = run<Silent>(msgs, alts, check2);
+  if (check1 != check2) { std::cerr << "different results\n"; return 1; }
+
+  std::cout << std::fixed << std::setprecision(2)
+            << "ns/byte     TrackErrors  NoErrorTracking  speedup\n"
+            << std::left << std::setw(12) << ""
+            << std::setw(13) << track << std::setw(17) << silent
+            << track / silent << "\n";
+  return 0;
+}
@@ -0,0 +1,111 @@
+// Compares the red-black tree map (`DDL::Map`) with the B-tree map
+// (`DDL::BTreeMap`) for maps with 10 to 1M entries.
+//
+// Usage: map-bench [MAX_SIZE]
+//
+// For each size we report the time per operation to build a map with
+// random keys, to look up all of its keys, and to insert into a shared
+// map (which copies the nodes on the path to the new entry).
+// As a baseline, we also report the time to build a `std::map`.
+
+#include <ddl/map.h>
+#include <ddl/btree_map.h>
+#include <ddl/number.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+using Key   = DDL::UInt<64>;
+using Value = DDL::UInt<64>;
+
+namespace {
+
+template <typename F>
+double nsPerOp(size_t ops, F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::nano> t =
+    std::chrono::steady_clock::now() - start;
+  return t.count() / ops;
+}
+
+struct Result { double build, lookup, shared; };
+
+template <typename M>
+Result run(std::vector<uint64_t> const &keys, size_t reps) {
+  Result r;
+  size_t const n = keys.size();
+  M m;
+
+  r.build = nsPerOp(n * reps, [&]() {
+    for (size_t k = 0; k < reps; ++k) {
+      m.free();
+      m = M();
+      for (auto x : keys) m = m.insert(Key(x), Value(x));
+    }
+  });
+
+  uint64_t found = 0;
+  r.lookup = nsPerOp(n * reps, [&]() {
+    for (size_t k = 0; k < reps; ++k)
+      for (auto x : keys) found += m.contains(Key(x));
+  });
+  if (found != n * reps) std::cerr << "missing keys\n";
+
+  // Each insert is into a shared map, so nothing can be updated in place.
+  size_t const shared = std::min<size_t>(n, 1000);
+  r.shared = nsPerOp(shared * reps, [&]() {
+    for (size_t k = 0; k < reps; ++k)
+      for (size_t i = 0; i < shared; ++i) {
+        m.copy();
+        M m1 = m.insert(Key(keys[i]), Value(0));
+        m1.free();
+      }
+  });
+
+  m.free();
+  return r;
+}
+
+double stdBuild(std::vector<uint64_t> const &keys, size_t reps) {
+  std::map<uint64_t,uint64_t> m;
+  return nsPerOp(keys.size() * reps, [&]() {
+    for (size_t k = 0; k < reps; ++k) {
+      m.clear();
+      for (auto x : keys) m.insert_or_assign(x, x);
+    }
+  });
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  size_t const max = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+  std::cout << "ns/op       build                    lookup           shared insert\n"
+            << "size        rb      btree    std     rb      btree    rb      btree\n";
+  std::mt19937_64 rng(1);
+  for (size_t n = 10; n <= max; n *= 10) {
+    std::vector<uint64_t> keys(n);
+    for (auto &k : keys) k = rng();
+    size_t const reps = std::max<size_t>(1, 1000000 / n);
+
+    Result rb = run<DDL::Map<Key,Value>>(keys, reps);
+    Result bt = run<DDL::BTreeMap<Key,Value>>(keys, reps);
+    double std_build = stdBuild(keys, reps);
+    std::cout << std::fixed << std::setprecision(1)
+              << std::left << std::setw(12) << n
+              << std::setw(8) << rb.build  << std::setw(9) << bt.build
+              << std::setw(8) << std_build
+              << std::setw(8) << rb.lookup << std::setw(9) << bt.lookup
+              << std::setw(8) << rb.shared << std::setw(9) << bt.shared
+              << "\n";
+  }
+  return 0;
+}
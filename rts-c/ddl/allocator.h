@@ -0,0 +1,314 @@
+#ifndef DDL_ALLOCATOR_H
+#define DDL_ALLOCATOR_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+namespace DDL {
+
+// A region allocator for the objects created during a parse.
+//
+// Small objects are carved out of large chunks with a bump pointer, and
+// objects whose reference count drops to 0 are pushed on a free list
+// for their size class, so that later allocations of the same size can
+// reuse them.  Large objects are allocated individually but are still
+// owned by the arena.
+//
+// Everything allocated in an arena is released at once by `release`
+// (or when the arena is destroyed), so values allocated in an arena
+// must not be used, or freed, after that.
+//
+// An arena is used by one thread at a time.  Objects that may be freed
+// by other threads, or after the arena is no longer current, should
+// be returned with `deallocateShared` instead of `deallocate`.
+class Arena {
+
+  static constexpr size_t granule   = 16;
+  static constexpr size_t classNum  = 32;
+  static constexpr size_t maxSmall  = granule * classNum;
+  static constexpr size_t chunkSize = 64 * 1024;
+
+  struct FreeBlock { FreeBlock *next; size_t bytes; };
+
+  // Headers are padded to a granule, to keep the objects after them aligned.
+  struct alignas(granule) Chunk { Chunk *next; };
+  struct alignas(granule) Large { Large *prev; Large *next; };
+
+  Chunk     *chunks;
+  char      *bump;
+  char      *limit;
+  Large     *large;
+  FreeBlock *free_lists[classNum];
+  size_t     in_use;      // Bytes in objects that have not been freed
+
+  // Objects returned with `deallocateShared`, waiting to be collected.
+  std::mutex shared_lock;
+  FreeBlock *shared_free;
+  bool       closed;      // No one is going to allocate from us any more
+
+  static size_t sizeClass(size_t bytes) {
+    return bytes == 0 ? 0 : (bytes - 1) / granule;
+  }
+
+  void newChunk() {
+    char *raw  = static_cast<char*>(::operator new(chunkSize));
+    Chunk *c   = reinterpret_cast<Chunk*>(raw);
+    c->next    = chunks;
+    chunks     = c;
+    bump       = raw + sizeof(Chunk);
+    limit      = raw + chunkSize;
+  }
+
+  void *allocateLarge(size_t bytes) {
+    char *raw = static_cast<char*>(::operator new(sizeof(Large) + bytes));
+    Large *l  = reinterpret_cast<Large*>(raw);
+    l->prev   = nullptr;
+    l->next   = large;
+    if (large != nullptr) large->prev = l;
+    large = l;
+    return raw + sizeof(Large);
+  }
+
+  void deallocateLarge(void *p) {
+    Large *l = reinterpret_cast<Large*>(static_cast<char*>(p) - sizeof(Large));
+    if (l->prev == nullptr) large = l->next; else l->prev->next = l->next;
+    if (l->next != nullptr) l->next->prev = l->prev;
+    ::operator delete(l);
+  }
+
+  void clearFreeLists() {
+    for (size_t i = 0; i < classNum; ++i) free_lists[i] = nullptr;
+  }
+
+public:
+  Arena()
+    : chunks(nullptr), bump(nullptr), limit(nullptr), large(nullptr), in_use(0)
+    , shared_free(nullptr), closed(false)
+  {
+    clearFreeLists();
+  }
+
+  Arena(Arena const&) = delete;
+  Arena& operator = (Arena const&) = delete;
+
+  ~Arena() {
+    release();
+    if (chunks != nullptr) ::operator delete(chunks);
+  }
+
+  // Allocate an uninitialized object of the given size.
+  // The result is aligned to 16 bytes.
+  void *allocate(size_t bytes) {
+    if (bytes > maxSmall) { in_use += bytes; return allocateLarge(bytes); }
+
+    size_t c     = sizeClass(bytes);
+    in_use      += (c + 1) * granule;
+    FreeBlock *b = free_lists[c];
+    if (b != nullptr) {
+      free_lists[c] = b->next;
+      return b;
+    }
+
+    size_t rounded = (c + 1) * granule;
+    if (static_cast<size_t>(limit - bump) < rounded) newChunk();
+    void *p = bump;
+    bump += rounded;
+    return p;
+  }
+
+  // Return an object to the arena.  `bytes` should be the same
+  // as the size used to allocate it.
+  void deallocate(void *p, size_t bytes) {
+    if (bytes > maxSmall) { in_use -= bytes; deallocateLarge(p); return; }
+    FreeBlock *b  = static_cast<FreeBlock*>(p);
+    size_t c      = sizeClass(bytes);
+    in_use       -= (c + 1) * granule;
+    b->next       = free_lists[c];
+    free_lists[c] = b;
+  }
+
+  // Return an object that may be freed on a different thread from the one
+  // using the arena, or after the arena was closed.  The object is reused
+  // after the arena's thread calls `collectShared`.  If the arena was
+  // closed, and this was its last object, the arena is deleted.
+  void deallocateShared(void *p, size_t bytes) {
+    bool last;
+    {
+      std::lock_guard<std::mutex> guard(shared_lock);
+      if (!closed) {
+        FreeBlock *b  = static_cast<FreeBlock*>(p);
+        b->next       = shared_free;
+        b->bytes      = bytes;
+        shared_free   = b;
+        return;
+      }
+      deallocate(p, bytes);
+      last = in_use == 0;
+    }
+    if (last) delete this;
+  }
+
+  // Return the objects freed with `deallocateShared` to the arena.
+  void collectShared() {
+    FreeBlock *b;
+    {
+      std::lock_guard<std::mutex> guard(shared_lock);
+      b           = shared_free;
+      shared_free = nullptr;
+    }
+    while (b != nullptr) {
+      FreeBlock *next = b->next;
+      deallocate(b, b->bytes);
+      b = next;
+    }
+  }
+
+  // For arenas allocated with `new`, whose objects may outlive the owner
+  // of the arena.  The owner calls this instead of deleting the arena,
+  // and should not use it after.  The arena is deleted now if all of its
+  // objects were freed, or when the last one is freed otherwise.
+  void close() {
+    bool last;
+    {
+      std::lock_guard<std::mutex> guard(shared_lock);
+      closed = true;
+      FreeBlock *b = shared_free;
+      shared_free  = nullptr;
+      while (b != nullptr) {
+        FreeBlock *next = b->next;
+        deallocate(b, b->bytes);
+        b = next;
+      }
+      last = in_use == 0;
+    }
+    if (last) delete this;
+  }
+
+  // Release all objects allocated in the arena.
+  // We keep the most recent chunk around so that the next parse
+  // does not need to allocate immediately.
+  void release() {
+    while (large != nullptr) {
+      Large *next = large->next;
+      ::operator delete(large);
+      large = next;
+    }
+
+    if (chunks != nullptr) {
+      Chunk *c = chunks->next;
+      while (c != nullptr) {
+        Chunk *next = c->next;
+        ::operator delete(c);
+        c = next;
+      }
+      chunks->next = nullptr;
+      bump  = reinterpret_cast<char*>(chunks) + sizeof(Chunk);
+      limit = reinterpret_cast<char*>(chunks) + chunkSize;
+    }
+
+    clearFreeLists();
+    in_use = 0;
+    std::lock_guard<std::mutex> guard(shared_lock);
+    shared_free = nullptr;
+  }
+
+  // How many bytes are used by objects that have not been freed
+  // (including the rounding to size classes).
+  size_t inUse() const { return in_use; }
+
+  // Was this object allocated in the arena?  Linear in the number of
+  // allocated chunks, so this is meant for debugging and testing.
+  bool contains(void const *p) const {
+    char const *q = static_cast<char const*>(p);
+    for (Chunk *c = chunks; c != nullptr; c = c->next) {
+      char const *start = reinterpret_cast<char const*>(c);
+      if (start <= q && q < start + chunkSize) return true;
+    }
+    for (Large *l = large; l != nullptr; l = l->next) {
+      if (reinterpret_cast<char const*>(l) + sizeof(Large) == q) return true;
+    }
+    return false;
+  }
+};
+
+
+// The arena used by the current thread, if any.
+inline
+Arena*& currentArena() {
+  static thread_local Arena *arena = nullptr;
+  return arena;
+}
+
+// Use the given arena for the runtime objects allocated by this thread
+// while the scope is active.  This only has an effect when the runtime
+// is compiled with `DDL_ARENA`.
+// Objects may be freed in a different scope from the one where they were
+// allocated (see `deallocate`), but objects allocated in the arena should
+// not be freed after the arena is released.
+class ArenaScope {
+  Arena *prev;
+public:
+  ArenaScope(Arena &a) : prev(currentArena()) { currentArena() = &a; }
+
+  // Use the given arena, or no arena if it is `nullptr`.
+  ArenaScope(Arena *a) : prev(currentArena()) { currentArena() = a; }
+
+  // Allocate outside of any arena while the scope is active.
+  // This is for objects that should outlive the current arena.
+  ArenaScope(std::nullptr_t) : prev(currentArena()) { currentArena() = nullptr; }
+  ~ArenaScope() { currentArena() = prev; }
+
+  ArenaScope(ArenaScope const&) = delete;
+  ArenaScope& operator = (ArenaScope const&) = delete;
+};
+
+
+// Allocation functions for runtime objects.
+//
+// With `DDL_ARENA`, each object starts with a header recording the arena
+// it came from, or `nullptr` if it came from the global heap.  This is so
+// that `deallocate` can return the object to where it came from, whatever
+// the current arena is when the object is freed.  For example, results
+// allocated in the arena of a parser are often freed after the parse,
+// possibly on a different thread.
+struct alignas(16) AllocHeader { Arena *owner; };
+
+inline
+void *allocate(size_t bytes) {
+#ifdef DDL_ARENA
+  Arena *a = currentArena();
+  size_t n = sizeof(AllocHeader) + bytes;
+  AllocHeader *h =
+    static_cast<AllocHeader*>(a == nullptr ? ::operator new(n) : a->allocate(n));
+  h->owner = a;
+  return h + 1;
+#else
+  return ::operator new(bytes);
+#endif
+}
+
+inline
+void deallocate(void *p, [[maybe_unused]] size_t bytes) {
+#ifdef DDL_ARENA
+  AllocHeader *h = static_cast<AllocHeader*>(p) - 1;
+  Arena *a = h->owner;
+  size_t n = sizeof(AllocHeader) + bytes;
+  if (a == nullptr)               ::operator delete(h);
+  else if (a == currentArena())   a->deallocate(h, n);
+  else                            a->deallocateShared(h, n);
+#else
+  ::operator delete(p);
+#endif
+}
+
+// Classes whose objects should be allocated with `allocate`
+// may extend this class.
+struct Allocated {
+  static void *operator new(size_t bytes) { return allocate(bytes); }
+  static void operator delete(void *p, size_t bytes) { deallocate(p, bytes); }
+};
+
+}
+
+#endif
@@ -7,7 +7,9 @@
 #include <functional>
 #include <vector>
 #include <string_view>
+#include <type_traits>
 
+#include <ddl/allocator.h>
 #include <ddl/debug.h>
 #include <ddl/list.h>
 #include <ddl/number.h>
@@ -17,32 +19,80 @@ namespace DDL {
 
 template <typename T> class Builder;
 class Stream;
+class StreamData;
 
 template <typename T>
 class Array : IsBoxed {
 
+public:
+  // Called to release external data, when the array is no longer used.
+  using Release = void (*)(void *ctx, T *elems, Size n);
+
+private:
   class Content {
     friend Array;
-    RefCount  ref_count;
+    RefCounter ref_count;
     Size      size;
+    T         *elems;     // Points to `data`, unless the elements are external
     T         data[];
 
+    // For arrays with external elements, this is stored instead of `data`.
+    // Slices are external arrays, whose `ctx` is the content of the
+    // array that owns the elements.
+    struct External {
+      Release release;
+      void    *ctx;
+    };
+
+    External *external() {
+      return reinterpret_cast<External*>(reinterpret_cast<char*>(this) +
+                                                              sizeof(Content));
+    }
 
   public:
     friend Builder<T>;
     friend Stream;
 
+    static
+    size_t bytes(Size n) { return sizeof(Content) + sizeof(T) * n.rep(); }
+
     // Allocate an array with unitialized data
     static
     Content *allocate(Size n) {
-      size_t bytes = sizeof(Content) + sizeof(T[n.rep()]);
-      char *raw = new char[bytes];    // XXX: alignment?
-      Content *p   = (Content*) raw;
-      p->ref_count = 1;
+      Content *p   = (Content*) DDL::allocate(bytes(n));
+      refInit(p->ref_count);
+      p->size      = n;
+      p->elems     = p->data;
+      return p;
+    }
+
+    // Make an array whose elements are stored elsewhere.
+    static
+    Content *allocateExternal(T *elems, Size n, Release r, void *ctx) {
+      Content *p   = (Content*) DDL::allocate(sizeof(Content) + sizeof(External));
+      refInit(p->ref_count);
       p->size      = n;
+      p->elems     = elems;
+      External *e  = p->external();
+      e->release   = r;
+      e->ctx       = ctx;
       return p;
     }
 
+    bool isExternal() const { return elems != data; }
+
+    // Release the memory for the array, the elements should have been freed.
+    static
+    void deallocate(Content *p) {
+      if (p->isExternal()) {
+        External *e = p->external();
+        if (e->release != nullptr) e->release(e->ctx, p->elems, p->size);
+        DDL::deallocate(p, sizeof(Content) + sizeof(External));
+      } else {
+        DDL::deallocate(p, bytes(p->size));
+      }
+    }
+
   } *ptr;
 
   Array(Content *p) : ptr(p) {}
@@ -57,6 +107,7 @@ class Array : IsBoxed {
 public:
   friend Builder<T>;
   friend Stream;
+  friend StreamData;
 
   static Array rangeUp(T start,T end, T step) {
     // step > 0 && step <= MAX(Size)
@@ -127,23 +178,77 @@ public:
     std::copy_n(data, n.rep(), ptr->data);
   }
 
+  // An array for a literal in the generated code.  Literals are stored
+  // in static variables and reused by all parses, so we allocate them
+  // outside of any arena.
+  static
+  Array literal(T const *data, Size n) {
+    ArenaScope noArena(nullptr);
+    return Array(data, n);
+  }
+
+  // An array whose elements are stored in memory that we don't own
+  // (e.g., a memory mapped file).  The elements are not copied,
+  // so they should not change while the array is in use.
+  // When the array is no longer used, we call `release` with `ctx`,
+  // unless it is `nullptr`.
+  static
+  Array external(T *elems, Size n, Release release, void *ctx) {
+    static_assert(!std::is_base_of<HasRefs,T>::value,
+                  "External arrays may not contain references");
+    return Array(Content::allocateExternal(elems, n, release, ctx));
+  }
+
+private:
+  static
+  void releaseBase(void *ctx, T *, Size) {
+    Array(static_cast<Content*>(ctx)).free();
+  }
+
+public:
+  // Owns this.
+  // An array with `n` elements, starting at `from`.
+  // The new array shares the elements of this one, so this does not
+  // copy them, and it takes constant time.
+  // Assumes: from + n <= size()
+  Array slice(Size from, Size n) {
+    assert(from.incrementedBy(n) <= size());
+    if (from == 0 && n == size()) return *this;
+
+    T *elems      = ptr->elems + from.rep();
+    Content *base = ptr;
+    if (base->isExternal()) {
+      typename Content::External *e = base->external();
+      if (e->release == releaseBase) {
+        // Share the original array, rather than this slice.
+        base = static_cast<Content*>(e->ctx);
+        Array(base).copy();
+        free();
+      }
+    }
+    return Array(Content::allocateExternal(elems, n, releaseBase, base));
+  }
+
+  // Owns this.  The elements starting at `from`.
+  Array slice(Size from) { return slice(from, size().decrementedBy(from)); }
+
   // Borrows this
   Size size() const { return ptr == nullptr ? 0 : ptr->size; }
 
   // Borrow this.
   // Returns a borrowed version of to element (if reference)
-  T borrowElement(Size i) const { return ptr->data[i.rep()]; }
+  T borrowElement(Size i) const { return ptr->elems[i.rep()]; }
 
   // Borrows this
   // Returns an owned copy of the element.
   T operator[] (Size i0) const {
     size_t i = i0.rep();
     if constexpr (std::is_base_of<HasRefs,T>::value) {
-      T& x = ptr->data[i];
+      T& x = ptr->elems[i];
       x.copy();
       return x;
     }
-    return ptr->data[i];
+    return ptr->elems[i];
   }
 
 
@@ -151,7 +256,7 @@ public:
     if(ptr == nullptr) {
       return nullptr;
     }
-    return (T*)&ptr->data;
+    return ptr->elems;
   }
 
   std::string_view borrowBytes() const { return borrowBytes(Size(0),size()); }
@@ -178,25 +283,26 @@ public:
 
 
 // -- Boxed --------------------------------------------------------------------
-  RefCount refCount() { return ptr == nullptr ? 0 : ptr->ref_count; }
+  RefCount refCount() { return ptr == nullptr ? 0 : refGet(ptr->ref_count); }
 
-  void copy() { if (ptr != nullptr) ptr->ref_count++; }
+  void copy() { if (ptr != nullptr) refInc(ptr->ref_count); }
 
   void free() {
     if (ptr == nullptr) return;
 
-    RefCount n = refCount();
-    if (n == 1) {
+    if (refDec(ptr->ref_count)) {
       if constexpr (std::is_base_of<HasRefs,T>::value) {
-        size_t todo = ptr->size.rep();
-        T* arr = ptr->data;
-        for(size_t i = 0; i < todo; ++i) arr[i].free();
+        // External elements are owned by someone else
+        // (e.g., the array we are a slice of).
+        if (!ptr->isExternal()) {
+          size_t todo = ptr->size.rep();
+          T* arr = ptr->elems;
+          for(size_t i = 0; i < todo; ++i) arr[i].free();
+        }
       }
       debug("  Freeing array "); debugValNL((void*)ptr);
-      delete[] (char*)ptr;
+      Content::deallocate(ptr);
       ptr = nullptr;
-    } else {
-      ptr->ref_count = n - 1;
     }
   }
 // -- Boxed --------------------------------------------------------------------
@@ -253,11 +359,46 @@ template <typename T>
 class Builder {
     List<std::vector<T>> list;
 
+    // owns l
+    Builder(List<std::vector<T>> l) : list(l) {}
+
   public:
     friend int compare<T> (Builder<T> b1, Builder<T> b2);
 
+    // An exclusive handle to a builder, which appends elements in place.
+    // The head of the list is made unique once, when the handle is made,
+    // so pushing does not need to look at reference counts.
+    // Use `freeze` to get the builder back.
+    class Transient {
+      List<std::vector<T>> list;
+    public:
+      Transient() : list(std::vector<T>(), List<std::vector<T>>()) {}
+
+      // owns b
+      explicit Transient(Builder b) {
+        if (b.list.refCount() == 1) list = b.list;
+        else list = List<std::vector<T>>(std::vector<T>(), b.list);
+      }
+
+      // owns x
+      void push(T x) { list.borrowHead().push_back(x); }
+
+      // The transient should not be used after this.
+      // returns owned
+      Builder freeze() {
+        Builder b(list);
+        list = List<std::vector<T>>();
+        return b;
+      }
+
+      void free() { freeze().free(); }
+    };
+
     Builder () : list() {}
 
+    // owns this
+    Transient transient() { return Transient(*this); }
+
     // owns x, xs
     Builder (Builder xs, T x) {
       if (xs.list.refCount() == 1) {
@@ -270,7 +411,7 @@ class Builder {
 
     // owns a, b
     Builder(Builder b, Array<T> a) {
-      auto beginData = a.ptr->data;
+      auto beginData = a.ptr->elems;
       auto endData = beginData + a.ptr->size.value;
 
       // support copy if array has 1 reference
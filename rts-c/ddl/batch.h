@@ -0,0 +1,227 @@
+#ifndef DDL_BATCH_H
+#define DDL_BATCH_H
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <algorithm>
+
+#include <ddl/parser.h>
+#include <ddl/utils.h>
+
+namespace DDL {
+
+// The order in which `parseBatch` reports the results.
+enum class BatchOrder {
+  Completion,     // As soon as a parse finishes
+  Input           // In the order of the inputs
+};
+
+struct BatchConfig {
+  size_t     workers = 0;       // 0 means one per hardware thread
+  BatchOrder order   = BatchOrder::Completion;
+};
+
+
+// Jobs for the workers of a batch.  Each worker has its own queue, and
+// takes jobs from the front of it.  When it runs out, it steals from
+// the back of the queues of the other workers.
+class BatchQueues {
+
+  struct Queue {
+    std::mutex         lock;
+    std::deque<size_t> jobs;
+  };
+
+  std::vector<Queue> queues;
+
+public:
+  // Split jobs `0 .. n-1` in contiguous blocks, one per worker.
+  BatchQueues(size_t workers, size_t n) : queues(workers) {
+    for (size_t w = 0; w < workers; ++w) {
+      size_t from = n * w / workers;
+      size_t to   = n * (w + 1) / workers;
+      for (size_t i = from; i < to; ++i) queues[w].jobs.push_back(i);
+    }
+  }
+
+  // Get the next job for the given worker.
+  // Returns `false` if there are no more jobs.
+  bool next(size_t worker, size_t &job) {
+    {
+      Queue &q = queues[worker];
+      std::lock_guard<std::mutex> guard(q.lock);
+      if (!q.jobs.empty()) {
+        job = q.jobs.front();
+        q.jobs.pop_front();
+        return true;
+      }
+    }
+    for (size_t i = 1; i < queues.size(); ++i) {
+      Queue &q = queues[(worker + i) % queues.size()];
+      std::lock_guard<std::mutex> guard(q.lock);
+      if (!q.jobs.empty()) {
+        job = q.jobs.back();
+        q.jobs.pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+
+// Parse many independent inputs in parallel.
+//
+// `parse` is the version of a generated entry point that takes a parser
+// state (i.e., `parseFWithState` for an entry point `F`).  Each worker thread makes its own parser state, using
+// `makeState(worker)`, and reuses it for all the inputs it parses.
+// So each worker also has its own arena for the values it makes
+// (see `ParserState::valueArena`).
+// For parsers without a user state, see the overload below.
+//
+// `consume(index, result, error)` is called once per input:
+//   * `index` is the index of the input in `inputs`,
+//   * `result` points to the semantic value, or is `nullptr` if the
+//     parse failed or was ambiguous.  The consumer owns the value.
+//   * `error` is the error reported by the parser.
+// Calls to `consume` are made from the worker threads, one at a time.
+// With `BatchOrder::Input` a result may be consumed on a different thread
+// from the one that parsed it.  Unless the runtime is compiled with
+// `DDL_ATOMIC_REFCOUNT`, this is only safe if the result does not share
+// data with the parsers (e.g., inputs should not share data).
+//
+// If `makeState`, `parse`, or `consume` throw an exception, the workers
+// stop taking new inputs, no more results are consumed, and once the
+// workers are done the exception is rethrown on the calling thread.
+// If there are many, we throw the one for the earliest input.
+//
+// Owns inputs.
+template <typename State, typename I, typename T,
+          typename MakeState, typename Consume>
+void parseBatch
+  ( void (*parse)(State&, ParseError<I>&, ResultSink<T>&, I)
+  , MakeState makeState
+  , std::vector<I> inputs
+  , Consume consume
+  , BatchConfig config = BatchConfig()
+  ) {
+
+  size_t const n = inputs.size();
+  size_t workers = config.workers;
+  if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+  workers = std::max<size_t>(1, std::min(workers, n));
+
+  BatchQueues queues(workers, n);
+
+  // Results that are waiting for earlier ones, when reporting in order.
+  struct Outcome {
+    bool          done = false;
+    bool          ok   = false;
+    T             value;
+    ParseError<I> error;
+  };
+  std::mutex           out_lock;
+  std::vector<Outcome> waiting(config.order == BatchOrder::Input ? n : 0);
+  size_t               next_out = 0;
+
+  // Set when something threw an exception, so we should stop.
+  std::atomic<bool>    stop(false);
+
+  auto report = [&](size_t i, bool ok, T value, ParseError<I> const &error) {
+    std::lock_guard<std::mutex> guard(out_lock);
+    if (stop) {
+      if (ok) value.free();
+      return;
+    }
+    try {
+      if (config.order == BatchOrder::Completion) {
+        consume(i, ok ? &value : nullptr, error);
+        return;
+      }
+      Outcome &o = waiting[i];
+      o.done  = true;
+      o.ok    = ok;
+      o.value = value;
+      o.error = error;
+      while (next_out < n && waiting[next_out].done) {
+        Outcome &r = waiting[next_out++];
+        r.done = false;
+        consume(next_out - 1, r.ok ? &r.value : nullptr, r.error);
+        r.error = ParseError<I>();
+      }
+    } catch (...) {
+      stop = true;    // No more calls to `consume`
+      throw;
+    }
+  };
+
+  // The exception for the earliest input, if any.
+  std::mutex         exn_lock;
+  std::exception_ptr exn;
+  size_t             exn_input = n;
+
+  auto work = [&](size_t w) {
+    std::vector<T> results;
+    size_t i = n;
+    try {
+      State p = makeState(w);
+      while (!stop && queues.next(w, i)) {
+        ParseError<I> error;
+        ResultSink<T> sink(results, 2);
+        parse(p, error, sink, inputs[i]);
+        bool ok = results.size() == 1;
+        if (!ok) for (auto && x : results) x.free();
+        T value = ok ? results[0] : T();
+        results.clear();
+        report(i, ok, value, error);
+      }
+    } catch (...) {
+      for (auto && x : results) x.free();
+      std::lock_guard<std::mutex> guard(exn_lock);
+      if (exn == nullptr || i < exn_input) {
+        exn       = std::current_exception();
+        exn_input = i;
+      }
+      stop = true;
+    }
+  };
+
+  if (workers == 1) work(0);
+  else {
+    std::vector<std::thread> threads;
+    threads.reserve(workers);
+    for (size_t w = 0; w < workers; ++w) threads.emplace_back(work, w);
+    for (auto &t : threads) t.join();
+  }
+
+  if (exn == nullptr) return;
+
+  // Free what we did not get to.
+  size_t i;
+  while (queues.next(0, i)) inputs[i].free();
+  for (auto &o : waiting) if (o.done && o.ok) o.value.free();
+  std::rethrow_exception(exn);
+}
+
+// Parse many independent inputs in parallel, using parser states
+// that do not need a user state.  See above for details.
+// Owns inputs.
+template <typename State, typename I, typename T, typename Consume>
+void parseBatch
+  ( void (*parse)(State&, ParseError<I>&, ResultSink<T>&, I)
+  , std::vector<I> inputs
+  , Consume consume
+  , BatchConfig config = BatchConfig()
+  ) {
+  parseBatch(parse, [](size_t) { return State(); },
+             std::move(inputs), consume, config);
+}
+
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <ddl/size.h>
 #include <ddl/debug.h>
+#include <ddl/allocator.h>
 
 namespace DDL {
 
@@ -24,8 +25,8 @@ class IsBoxed : public HasRefs {};
 
 
 template <typename T>
-struct BoxedValue {
-  RefCount  ref_count;
+struct BoxedValue : Allocated {
+  RefCounter ref_count;
   T         value;
   BoxedValue()    : ref_count(1) {}
   BoxedValue(T x) : ref_count(1), value(x) {}
@@ -39,31 +40,25 @@ bool hasRefs() { return std::is_base_of<HasRefs,T>::value; }
 // Relese this reference to the box.
 template <typename T>
 void free_boxed(BoxedValue<T> *ptr) {
-  RefCount n = ptr->ref_count;
-  if (n == 1) {
+  if (refDec(ptr->ref_count)) {
     if constexpr (hasRefs<T>()) ptr->value.free();
     debug("  freeing boxed "); debugValNL((void*) ptr);
     delete ptr;
   }
-  else {
-    ptr->ref_count = n - 1;
-  }
 }
 
 // Relese this reference to the box, and we've already extracted its
 // content so we don't free it.
 template <typename T>
 void shallow_free_boxed(BoxedValue<T> *ptr) {
-  RefCount n = ptr->ref_count;
-  if (n == 1) delete ptr;
-  else ptr->ref_count = n - 1;
+  if (refDec(ptr->ref_count)) delete ptr;
 }
 
 
 // Relese this reference to the box.
 template <typename T>
 inline
-void copy_boxed(BoxedValue<T> *ptr) { ++(ptr->ref_count); }
+void copy_boxed(BoxedValue<T> *ptr) { refInc(ptr->ref_count); }
 
 
 
@@ -85,7 +80,7 @@ public:
 
   bool isNull() { return ptr == NULL; }
 
-  RefCount refCount() { return ptr->ref_count; }
+  RefCount refCount() { return refGet(ptr->ref_count); }
 
   // Allocate without initializing the data, but ref count is 1
   void allocate() { ptr = new BoxedValue<T>(); }
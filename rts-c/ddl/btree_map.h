@@ -0,0 +1,507 @@
+// A persistent B-tree, with the same interface as `DDL::Map`.
+//
+// Nodes store up to `maxKeys` sorted entries, so lookups touch a few
+// cache lines per level rather than one node per comparison, and an
+// insert copies O(log_B n) nodes instead of O(log_2 n).  As in `Map`,
+// nodes are reference counted and only copied when they are shared,
+// so building a map that is not shared updates it in place.
+
+#ifndef DDL_BTREE_MAP_H
+#define DDL_BTREE_MAP_H
+
+#include <assert.h>
+#include <ddl/debug.h>
+#include <ddl/allocator.h>
+#include <ddl/boxed.h>
+#include <ddl/maybe.h>
+
+namespace DDL {
+
+template <typename Key, typename Value>
+class BTreeMap : HasRefs {
+
+  static constexpr unsigned minDegree = 8;
+  static constexpr unsigned maxKeys   = 2 * minDegree - 1;
+
+  // Empty maps are represented as a null pointer.
+  struct Node : Allocated {
+    RefCounter ref_count;
+    unsigned   n;                   // Number of entries
+    bool       leaf;
+    Key        keys[maxKeys];       // Owned, the first `n`
+    Value      values[maxKeys];     // Owned, the first `n`
+    Node      *kids[maxKeys + 1];   // Owned, the first `n + 1`, if not leaf
+
+    Node(bool leaf) : ref_count(1), n(0), leaf(leaf) {}
+
+    // Borrow p
+    Node(Node const *p) : ref_count(1), n(p->n), leaf(p->leaf) {
+      for (unsigned i = 0; i < n; ++i) {
+        keys[i]   = p->keys[i];
+        values[i] = p->values[i];
+        if constexpr (hasRefs<Key>())   keys[i].copy();
+        if constexpr (hasRefs<Value>()) values[i].copy();
+      }
+      if (!leaf) {
+        for (unsigned i = 0; i <= n; ++i) {
+          kids[i] = p->kids[i];
+          copy(kids[i]);
+        }
+      }
+    }
+
+    static void copy(Node *p) { if (p != nullptr) refInc(p->ref_count); }
+
+    static void free(Node *p) {
+      if (p == nullptr || !refDec(p->ref_count)) return;
+      for (unsigned i = 0; i < p->n; ++i) {
+        if constexpr (hasRefs<Key>())   p->keys[i].free();
+        if constexpr (hasRefs<Value>()) p->values[i].free();
+      }
+      if (!p->leaf) for (unsigned i = 0; i <= p->n; ++i) free(p->kids[i]);
+      delete p;
+    }
+
+    // Return a node that has the same data as `p` but is guaranteed to
+    // be unique.  If `p` was already unique than we can reuse it.
+    // owns p
+    static Node* makeCopy(Node *p) {
+      if (refGet(p->ref_count) == 1) return p;
+      Node *res = new Node(p);
+      free(p);
+      return res;
+    }
+
+    // The index of the first key that is not smaller than `k`.
+    // Nodes are small, so a linear scan is faster than a binary search.
+    // borrow this, borrow k
+    unsigned lowerBound(Key k) const {
+      unsigned i = 0;
+      while (i < n && keys[i] < k) ++i;
+      return i;
+    }
+
+    // borrow k, borrow p
+    // Returns a borrowed reference to the node containing the key, if any,
+    // and the index of the key in it.
+    static Node* findNode(Key k, Node *p, unsigned &i) {
+      while (p != nullptr) {
+        i = p->lowerBound(k);
+        if (i < p->n && !(k < p->keys[i])) return p;
+        if (p->leaf) return nullptr;
+        p = p->kids[i];
+      }
+      return nullptr;
+    }
+
+    // Make room for an entry at position `i`.
+    // Assumes: unique, n < maxKeys
+    void shiftRight(unsigned i) {
+      for (unsigned j = n; j > i; --j) {
+        keys[j]   = keys[j - 1];
+        values[j] = values[j - 1];
+      }
+      if (!leaf) for (unsigned j = n + 1; j > i + 1; --j) kids[j] = kids[j - 1];
+    }
+
+    // Split the full child `i` in two, moving its middle entry to us.
+    // Assumes: this and kids[i] are unique, n < maxKeys
+    void splitChild(unsigned i) {
+      Node *y = kids[i];
+      Node *z = new Node(y->leaf);
+      z->n = minDegree - 1;
+      for (unsigned j = 0; j < minDegree - 1; ++j) {
+        z->keys[j]   = y->keys[j + minDegree];
+        z->values[j] = y->values[j + minDegree];
+      }
+      if (!y->leaf)
+        for (unsigned j = 0; j < minDegree; ++j)
+          z->kids[j] = y->kids[j + minDegree];
+      y->n = minDegree - 1;
+
+      shiftRight(i);
+      keys[i]     = y->keys[minDegree - 1];
+      values[i]   = y->values[minDegree - 1];
+      kids[i + 1] = z;
+      ++n;
+    }
+
+    // Replace the value at position `i`.
+    // owns k, owns v
+    void replace(unsigned i, Key k, Value v) {
+      if constexpr (hasRefs<Key>())   k.free();
+      if constexpr (hasRefs<Value>()) values[i].free();
+      values[i] = v;
+    }
+
+    // owns k, own v, own p
+    // returns an owned *unique* node
+    static Node* insert(Key k, Value v, Node *p) {
+      if (p == nullptr) {
+        Node *r = new Node(true);
+        r->keys[0]   = k;
+        r->values[0] = v;
+        r->n         = 1;
+        return r;
+      }
+
+      Node *root = makeCopy(p);
+      if (root->n == maxKeys) {
+        Node *r = new Node(false);
+        r->kids[0] = root;
+        r->splitChild(0);
+        root = r;
+      }
+
+      // Going down, we split full nodes, so there is always room
+      // to move an entry up from a child.
+      Node *x = root;
+      for (;;) {
+        unsigned i = x->lowerBound(k);
+        if (i < x->n && !(k < x->keys[i])) { x->replace(i, k, v); break; }
+
+        if (x->leaf) {
+          x->shiftRight(i);
+          x->keys[i]   = k;
+          x->values[i] = v;
+          ++x->n;
+          break;
+        }
+
+        Node *c = makeCopy(x->kids[i]);
+        x->kids[i] = c;
+        if (c->n == maxKeys) {
+          x->splitChild(i);
+          if (!(x->keys[i] < k)) {
+            if (!(k < x->keys[i])) { x->replace(i, k, v); break; }
+          } else {
+            ++i;
+          }
+        }
+        x = x->kids[i];
+      }
+      return root;
+    }
+
+    static void dump(int tab, Node *p) {
+      if (p == nullptr) return;
+      for (int i = 0; i < tab; ++i) debug(" ");
+      debugVal((void*)p);
+      debug("("); debugVal(refGet(p->ref_count)); debugLine(")");
+      for (unsigned i = 0; i <= p->n; ++i) {
+        if (!p->leaf) dump(tab + 2, p->kids[i]);
+        if (i == p->n) break;
+        for (int j = 0; j < tab; ++j) debug(" ");
+        debug("Key:"); debugVal(p->keys[i]);
+        debug(" Val:"); debugValNL(p->values[i]);
+      }
+    }
+
+    friend
+    std::ostream& operator << (std::ostream &os, Node *p) {
+      if (p == nullptr) return os;
+      for (unsigned i = 0; i <= p->n; ++i) {
+        if (!p->leaf) {
+          os << p->kids[i];
+          if (i < p->n) os << ", ";
+        }
+        if (i == p->n) break;
+        os << p->keys[i] << " -> " << p->values[i];
+        if (p->leaf && i + 1 < p->n) os << ", ";
+      }
+      return os;
+    }
+
+    // Returns depth on success, 0 on failure
+    static unsigned valid(Node const *p, bool root) {
+      if (p == nullptr) return root ? 1 : 0;
+      if (p->n > maxKeys || p->n == 0) return 0;
+      if (!root && p->n < minDegree - 1) return 0;
+      for (unsigned i = 1; i < p->n; ++i)
+        if (!(p->keys[i - 1] < p->keys[i])) return 0;
+      if (p->leaf) return 1;
+
+      unsigned depth = 0;
+      for (unsigned i = 0; i <= p->n; ++i) {
+        Node const *c = p->kids[i];
+        if (c == nullptr) return 0;
+        if (i > 0    && !(p->keys[i - 1] < c->keys[0]))     return 0;
+        if (i < p->n && !(c->keys[c->n - 1] < p->keys[i]))  return 0;
+        unsigned d = valid(c, false);
+        if (d == 0 || (depth != 0 && d != depth)) return 0;
+        depth = d;
+      }
+      return depth + 1;
+    }
+
+  } *tree;
+
+  BTreeMap(Node *p) : tree(p) {}
+
+public:
+
+  class Iterator : HasRefs {
+
+    // The path from the current entry to the root.  Frames are shared
+    // between copies of the iterator.  The entry of a frame is the next
+    // one to visit in its node, which is past the end when there
+    // are no more entries in the node.
+    struct Frame : Allocated {
+      RefCounter ref_count;
+      Node      *node;       // Owned
+      unsigned   index;
+      Frame     *up;         // Owned, nullable
+
+      Frame(Node *node, unsigned index, Frame *up)
+        : ref_count(1), node(node), index(index), up(up) {}
+    };
+
+    Frame *cur;     // Owned, nullable.  Null when done.
+
+    static void copyFrame(Frame *f) { if (f != nullptr) refInc(f->ref_count); }
+
+    static void freeFrame(Frame *f) {
+      while (f != nullptr && refDec(f->ref_count)) {
+        Frame *up = f->up;
+        Node::free(f->node);
+        delete f;
+        f = up;
+      }
+    }
+
+    // Replace the top frame with one at a different index in the same node.
+    // owns f
+    static Frame* setIndex(Frame *f, unsigned i) {
+      if (refGet(f->ref_count) == 1) { f->index = i; return f; }
+      Node::copy(f->node);
+      copyFrame(f->up);
+      Frame *g = new Frame(f->node, i, f->up);
+      freeFrame(f);
+      return g;
+    }
+
+    // owns up, owns p
+    // Assumes `p` is not nullptr
+    // Push frames going all the way left.
+    static Frame* goLeft(Frame *up, Node *p) {
+      for (;;) {
+        up = new Frame(p, 0, up);
+        if (p->leaf) return up;
+        p = p->kids[0];
+        Node::copy(p);
+      }
+    }
+
+  public:
+    Iterator() : cur(nullptr) {}
+
+    // Owns argument
+    Iterator(BTreeMap m)
+      : cur(m.tree == nullptr ? nullptr : goLeft(nullptr, m.tree)) {}
+
+    // borrow this
+    bool  done()        { return cur == nullptr; }
+
+    // borrow this, return owned
+    Key   key() {
+      Key k = borrowKey();
+      if constexpr (hasRefs<Key>()) k.copy();
+      return k;
+    }
+
+    // borrow this, return owned
+    Value value() {
+      Value v = borrowValue();
+      if constexpr (hasRefs<Value>()) v.copy();
+      return v;
+    }
+
+    // borrow this
+    Key   borrowKey()   { return cur->node->keys[cur->index]; }
+
+    // borrow this
+    Value borrowValue() { return cur->node->values[cur->index]; }
+
+    // owns this
+    Iterator next() {
+      Iterator r;
+      Node *p    = cur->node;
+      unsigned i = cur->index + 1;
+
+      if (!p->leaf) {
+        Node *kid = p->kids[i];
+        Node::copy(kid);
+        r.cur = goLeft(setIndex(cur, i), kid);
+        return r;
+      }
+
+      if (i < p->n) { r.cur = setIndex(cur, i); return r; }
+
+      // Go up until we find a node with more entries.
+      Frame *f = cur;
+      for (;;) {
+        Frame *up = f->up;
+        copyFrame(up);
+        freeFrame(f);
+        f = up;
+        if (f == nullptr || f->index < f->node->n) break;
+      }
+      r.cur = f;
+      return r;
+    }
+
+    void copy() { copyFrame(cur); }
+    void free() { freeFrame(cur); }
+
+    void dump() {
+      debug("IT:");
+      for (Frame *f = cur; f != nullptr; f = f->up) {
+        debugVal((void*)f->node); debug("@"); debugVal(f->index); debug(" ");
+      }
+      debugLine("---");
+    }
+  };
+
+
+  // Make an empty map
+  BTreeMap() : tree(nullptr) {}
+
+  // owns k, v, and this
+  BTreeMap insert(Key k, Value v) { return BTreeMap(Node::insert(k,v,tree)); }
+
+  // borrow this, borrow k
+  bool contains(Key k) {
+    unsigned i;
+    return Node::findNode(k,tree,i) != nullptr;
+  }
+
+  // borrow this, borrow k, own result
+  Maybe<Value> lookup(Key k) {
+    unsigned i;
+    Node *x = Node::findNode(k,tree,i);
+    if (x == nullptr) return Maybe<Value>();
+    if constexpr (hasRefs<Value>()) x->values[i].copy();
+    return Maybe<Value>(x->values[i]);
+  }
+
+  // reference counting
+  void copy() { Node::copy(tree); }
+  void free() { Node::free(tree); }
+
+  // for debugging
+  void dump() { Node::dump(0,tree); debugNL(); }
+
+  bool valid() const { return Node::valid(tree, true) > 0; }
+
+  friend
+  // borrow m
+  std::ostream& operator << (std::ostream &os, BTreeMap m) {
+    os << "[| " << m.tree << " |]";
+    return os;
+  }
+
+};
+
+
+
+template <typename Key, typename Value>
+static inline
+int compare(BTreeMap<Key,Value> m1, BTreeMap<Key,Value> m2) {
+  m1.copy();
+  m2.copy();
+  typename BTreeMap<Key,Value>::Iterator it1(m1);
+  typename BTreeMap<Key,Value>::Iterator it2{m2};
+  int result;
+  while (! (it1.done() || it2.done())) {
+    Key k1 = it1.borrowKey();
+    Key k2 = it2.borrowKey();
+    result = compare(k1,k2);
+    if (result != 0) goto end;
+
+    Value v1 = it1.borrowValue();
+    Value v2 = it2.borrowValue();
+    result = compare(v1,v2);
+    if (result != 0) goto end;
+
+    it1 = it1.next();
+    it2 = it2.next();
+  }
+
+  result = it1.done() && it2.done() ? 0
+         : it1.done() ? -1 : 1;
+
+end:
+  it1.free();
+  it2.free();
+  return result;
+}
+
+
+// Borrow arguments
+template <typename Key, typename Value> static inline
+bool operator == (BTreeMap<Key,Value> xs, BTreeMap<Key,Value> ys) {
+  return compare(xs,ys) == 0;
+}
+
+// Borrow arguments
+template <typename Key, typename Value> static inline
+bool operator < (BTreeMap<Key,Value> xs, BTreeMap<Key,Value> ys) {
+  return compare(xs,ys) < 0;
+}
+
+// Borrow arguments
+template <typename Key, typename Value> static inline
+bool operator > (BTreeMap<Key,Value> xs, BTreeMap<Key,Value> ys) {
+  return compare(xs,ys) > 0;
+}
+
+// Borrow arguments
+template <typename Key, typename Value> static inline
+bool operator != (BTreeMap<Key,Value> xs, BTreeMap<Key,Value> ys) {
+  return !(xs == ys);
+}
+
+// Borrow arguments
+template <typename Key, typename Value> static inline
+bool operator <= (BTreeMap<Key,Value> xs, BTreeMap<Key,Value> ys) {
+  return !(xs > ys);
+}
+
+// Borrow arguments
+template <typename Key, typename Value> static inline
+bool operator >= (BTreeMap<Key,Value> xs, BTreeMap<Key,Value> ys) {
+  return !(xs < ys);
+}
+
+
+// borrow
+template <typename Key, typename Value>
+inline
+std::ostream& toJS(std::ostream& os, BTreeMap<Key,Value> x) {
+  os << "{ \"$$map\":";
+  char sep = '[';
+  x.copy();
+  typename BTreeMap<Key,Value>::Iterator it(x);
+  if (it.done()) { os << "["; goto end; }
+  do {
+    os << sep << "[";
+    toJS(os,it.borrowKey());
+    os << ",";
+    toJS(os,it.borrowValue());
+    os << "]";
+    sep = ',';
+    it = it.next();
+  } while(!it.done());
+
+end:
+  it.free();
+  os << "]}";
+  return os;
+}
+
+
+}
+
+
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef DDL_BYTESET_H
+#define DDL_BYTESET_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define DDL_BYTESET_X86 1
+#include <immintrin.h>
+#endif
+
+namespace DDL {
+
+// A set of bytes, used to scan quickly over inputs.
+//
+// The set is stored as two tables indexed by the low 4 bits of a byte.
+// Bit `k` of `lo[i]` says if `16 * k + i` is in the set, and similarly
+// `hi[i]` is for the bytes with the top bit set.  This is the layout
+// used by the vectorized scanners, which test 16 or 32 bytes at once
+// using byte shuffles.
+class ByteSet {
+  alignas(16) uint8_t lo[16];
+  alignas(16) uint8_t hi[16];
+
+  friend struct ByteSetScan;
+
+public:
+  // The empty set
+  ByteSet() : lo{}, hi{} {}
+
+  // The set of bytes satisfying the given predicate.
+  template <typename P>
+  static
+  ByteSet fromPredicate(P p) {
+    ByteSet s;
+    for (unsigned b = 0; b < 256; ++b)
+      if (p(static_cast<uint8_t>(b))) s.insert(static_cast<uint8_t>(b));
+    return s;
+  }
+
+  // The bytes in the range [from,to]
+  static
+  ByteSet range(uint8_t from, uint8_t to) {
+    return fromPredicate([from,to](uint8_t b) { return from <= b && b <= to; });
+  }
+
+  void insert(uint8_t b) {
+    uint8_t *tab = b < 0x80 ? lo : hi;
+    tab[b & 0x0f] |= uint8_t(1u << ((b >> 4) & 7));
+  }
+
+  bool contains(uint8_t b) const {
+    uint8_t const *tab = b < 0x80 ? lo : hi;
+    return (tab[b & 0x0f] >> ((b >> 4) & 7)) & 1;
+  }
+
+  ByteSet complement() const {
+    ByteSet s;
+    for (size_t i = 0; i < 16; ++i) {
+      s.lo[i] = ~lo[i];
+      s.hi[i] = ~hi[i];
+    }
+    return s;
+  }
+
+  ByteSet operator | (ByteSet const &other) const {
+    ByteSet s;
+    for (size_t i = 0; i < 16; ++i) {
+      s.lo[i] = lo[i] | other.lo[i];
+      s.hi[i] = hi[i] | other.hi[i];
+    }
+    return s;
+  }
+
+  // The number of bytes at the start of `bytes` that are in the set.
+  inline size_t span(char const *bytes, size_t n) const;
+
+  // The index of the first byte in `bytes` that is in the set,
+  // or `n` if there is no such byte.
+  inline size_t find(char const *bytes, size_t n) const;
+};
+
+
+// The implementations of the scanners.
+// `first` returns the index of the first byte whose membership is `want`,
+// or `n` if there is no such byte.
+struct ByteSetScan {
+
+  using Fun = size_t (*)(ByteSet const&, bool want, char const*, size_t);
+
+  static
+  size_t firstScalar(ByteSet const &s, bool want, char const *p, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      if (s.contains(static_cast<uint8_t>(p[i])) == want) return i;
+    return n;
+  }
+
+#ifdef DDL_BYTESET_X86
+  __attribute__((target("ssse3")))
+  static
+  size_t firstSSSE3(ByteSet const &s, bool want, char const *p, size_t n) {
+    __m128i const tlo  = _mm_load_si128(reinterpret_cast<__m128i const*>(s.lo));
+    __m128i const thi  = _mm_load_si128(reinterpret_cast<__m128i const*>(s.hi));
+    __m128i const bits = _mm_setr_epi8(1,2,4,8,16,32,64,-128,
+                                       1,2,4,8,16,32,64,-128);
+    __m128i const nib  = _mm_set1_epi8(0x0f);
+    __m128i const seven = _mm_set1_epi8(7);
+    unsigned const flip = want ? 0 : 0xffff;
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      __m128i v    = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+      __m128i l    = _mm_and_si128(v, nib);
+      __m128i h    = _mm_and_si128(_mm_srli_epi16(v, 4), nib);
+      __m128i top  = _mm_cmpgt_epi8(h, seven);
+      __m128i row  = _mm_or_si128(
+                       _mm_andnot_si128(top, _mm_shuffle_epi8(tlo, l)),
+                       _mm_and_si128(top, _mm_shuffle_epi8(thi, l)));
+      __m128i bit  = _mm_shuffle_epi8(bits, h);
+      __m128i in   = _mm_cmpeq_epi8(_mm_and_si128(row, bit), bit);
+      unsigned m   = (unsigned(_mm_movemask_epi8(in)) ^ flip) & 0xffff;
+      if (m != 0) return i + __builtin_ctz(m);
+    }
+    return i + firstScalar(s, want, p + i, n - i);
+  }
+
+  __attribute__((target("avx2")))
+  static
+  size_t firstAVX2(ByteSet const &s, bool want, char const *p, size_t n) {
+    __m256i const tlo  = _mm256_broadcastsi128_si256(
+                  _mm_load_si128(reinterpret_cast<__m128i const*>(s.lo)));
+    __m256i const thi  = _mm256_broadcastsi128_si256(
+                  _mm_load_si128(reinterpret_cast<__m128i const*>(s.hi)));
+    __m256i const bits = _mm256_setr_epi8(1,2,4,8,16,32,64,-128,
+                                          1,2,4,8,16,32,64,-128,
+                                          1,2,4,8,16,32,64,-128,
+                                          1,2,4,8,16,32,64,-128);
+    __m256i const nib  = _mm256_set1_epi8(0x0f);
+    __m256i const seven = _mm256_set1_epi8(7);
+    uint32_t const flip = want ? 0 : 0xffffffff;
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+      __m256i v    = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i));
+      __m256i l    = _mm256_and_si256(v, nib);
+      __m256i h    = _mm256_and_si256(_mm256_srli_epi16(v, 4), nib);
+      __m256i top  = _mm256_cmpgt_epi8(h, seven);
+      __m256i row  = _mm256_blendv_epi8(_mm256_shuffle_epi8(tlo, l),
+                                        _mm256_shuffle_epi8(thi, l), top);
+      __m256i bit  = _mm256_shuffle_epi8(bits, h);
+      __m256i in   = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit);
+      uint32_t m   = uint32_t(_mm256_movemask_epi8(in)) ^ flip;
+      if (m != 0) return i + __builtin_ctz(m);
+    }
+    return i + firstSSSE3(s, want, p + i, n - i);
+  }
+#endif
+
+  // The best implementation supported by this CPU.
+  static
+  Fun best() {
+#ifdef DDL_BYTESET_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))  return firstAVX2;
+    if (__builtin_cpu_supports("ssse3")) return firstSSSE3;
+#endif
+    return firstScalar;
+  }
+
+  static
+  size_t first(ByteSet const &s, bool want, char const *p, size_t n) {
+    static Fun const impl = best();
+    return impl(s, want, p, n);
+  }
+};
+
+size_t ByteSet::span(char const *bytes, size_t n) const {
+  return ByteSetScan::first(*this, false, bytes, n);
+}
+
+size_t ByteSet::find(char const *bytes, size_t n) const {
+  return ByteSetScan::first(*this, true, bytes, n);
+}
+
+}
+
+#endif
@@ -214,7 +214,7 @@ template <Width out>
 inline
 Maybe<UInt<out>> integer_to_uint_maybe(Integer x) {
   using Res = UInt<out>;
-  if (x.isNatural() && mpz_sizeinbase(x.getValue().get_mpz_t(), 2) <= out) {
+  if (x.fitsUnsigned(out)) {
     typename Res::Rep v;
     x.exportI(v);
     return Maybe<Res>(Res{v});
@@ -227,25 +227,12 @@ template <Width out>
 inline
 Maybe<SInt<out>> integer_to_sint_maybe(Integer x) {
   using Res = SInt<out>;
-  mpz_class& c = x.getValue();
-
-  if (mpz_fits_slong_p(c.get_mpz_t())) {
-    long int v = mpz_get_si(c.get_mpz_t());
-    return (Res::minValRep() <= v && v <= Res::maxValRep())
-           ? Maybe<Res>(Res{static_cast<typename Res::Rep>(v)})
-           : Maybe<Res>();
-  }
-
-  if constexpr (out <= 8 * sizeof(long)) return Maybe<Res>();
-  else {
-    // doesn't fit in a long, and out is a big type
-    typename Res::Rep r;
-    x.exportI(r);
-    Integer check{r};
-    bool ok = check == x;
-    check.free();
-    return ok ? Maybe<Res>(Res{r}) : Maybe<Res>();
+  if (x.fitsSigned(out)) {
+    typename Res::Rep v;
+    x.exportI(v);
+    return Maybe<Res>(Res{v});
   }
+  return Maybe<Res>();
 }
 
 
@@ -0,0 +1,111 @@
+#ifndef DDL_FILE_INPUT_H
+#define DDL_FILE_INPUT_H
+
+// Loading inputs from files, without copying the bytes.
+// This uses POSIX functions, so it is in its own header.
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ddl/input.h>
+
+namespace DDL {
+
+// How the parser is going to access the input.
+// This is a hint for the operating system, when the file is mapped.
+enum class InputAccess {
+  Sequential,     // Mostly from start to end (e.g., a stream of packets)
+  Random          // By offset (e.g., a file with an index, like PDF)
+};
+
+namespace FileInput {
+
+inline
+void unmap(void *, UInt<8> *bytes, Size n) { munmap(bytes, n.rep()); }
+
+inline
+void freeBuffer(void *buf, UInt<8> *, Size) { std::free(buf); }
+
+// Read everything from a file descriptor into a buffer that doubles in
+// size as needed.  This is for pipes and other files we cannot map.
+inline
+bool readAll(int fd, char const *name, Input *input) {
+  size_t cap  = 64 * 1024;
+  size_t used = 0;
+  char  *buf  = static_cast<char*>(std::malloc(cap));
+  if (buf == nullptr) return false;
+
+  while (true) {
+    if (used == cap) {
+      char *bigger = static_cast<char*>(std::realloc(buf, 2 * cap));
+      if (bigger == nullptr) { std::free(buf); return false; }
+      buf = bigger;
+      cap *= 2;
+    }
+    ssize_t n = read(fd, buf + used, cap - used);
+    if (n == 0) break;
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      std::free(buf);
+      return false;
+    }
+    used += n;
+  }
+
+  *input = Input(name, buf, Size::from(used), freeBuffer, buf);
+  return true;
+}
+
+}
+
+// Make an input with the contents of an open file.  Regular files are
+// mapped into memory, other files (e.g., pipes) are read into a buffer.
+// Either way, the bytes are not copied again by the input, and are
+// released when the input and everything derived from it are freed.
+// Does not close `fd`.
+// Returns `false` if we could not read the file.
+inline
+bool inputFromFd(int fd, char const *name, Input *input,
+                 InputAccess access = InputAccess::Sequential) {
+  struct stat info;
+  if (fstat(fd, &info) != 0) return false;
+
+  if (!S_ISREG(info.st_mode)) return FileInput::readAll(fd, name, input);
+
+  size_t len = info.st_size;
+  if (len == 0) { *input = Input(name, "", Size{0}); return true; }
+
+  void *bytes = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (bytes == MAP_FAILED) return FileInput::readAll(fd, name, input);
+
+  madvise(bytes, len, access == InputAccess::Random ? MADV_RANDOM
+                                                    : MADV_SEQUENTIAL);
+  *input = Input(name, static_cast<char const*>(bytes), Size::from(len),
+                 FileInput::unmap, nullptr);
+  return true;
+}
+
+// Make an input with the contents of a file, see `inputFromFd`.
+// The file name `-` refers to the standard input.
+// The input is named after the file.
+inline
+bool inputFromFile(char const *file, Input *input,
+                   InputAccess access = InputAccess::Sequential) {
+  if (std::strcmp(file, "-") == 0) return inputFromFd(0, file, input, access);
+
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) return false;
+  bool ok = inputFromFd(fd, file, input, access);
+  close(fd);
+  return ok;
+}
+
+}
+
+#endif
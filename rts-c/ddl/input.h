@@ -8,6 +8,7 @@
 #include <ddl/debug.h>
 #include <ddl/boxed.h>
 #include <ddl/array.h>
+#include <ddl/byteset.h>
 #include <ddl/number.h>
 #include <ddl/integer.h>
 #include <ddl/maybe.h>
@@ -54,6 +55,20 @@ public:
     , last_offset(len)
     {}
 
+  // Does not copy the bytes, which should remain valid and unchanged
+  // until `release` is called with `ctx` (e.g., `munmap`).
+  // This happens when the input, and all inputs and arrays derived
+  // from it, are no longer used.  If `release` is `nullptr`, the bytes
+  // are not released, so they should outlive all uses of the input.
+  // The name is copied.
+  Input(const char *nm, const char *by, Size len,
+        Array<UInt<8>>::Release release, void *ctx)
+    : name(Array<UInt<8>>((UInt<8>*)nm, Size::from(strlen(nm))))
+    , bytes(Array<UInt<8>>::external((UInt<8>*)by, len, release, ctx))
+    , offset(Size{0})
+    , last_offset(len)
+    {}
+
   void dumpInput() {
     debug("[");   debugVal((void*) name.borrowData());
     debug(",");   debugVal((void*) bytes.borrowData());
@@ -118,10 +133,24 @@ public:
   bool hasPrefix(DDL::Array<UInt<8>> pref) {
     Size n = pref.size();
     if (length() < n) return false;
-    for (Size i = Size{0}; i < n; i.increment()) {
-      if (bytes[offset.incrementedBy(i)] != pref[i]) return false;
-    }
-    return true;
+    if (n == 0) return true;
+    return memcmp( bytes.borrowData() + offset.rep()
+                 , pref.borrowData()
+                 , n.rep()
+                 ) == 0;
+  }
+
+  // borrow this.
+  // The number of bytes at the start of the input that are in the set.
+  Size spanOf(ByteSet const &set) const {
+    return Size::from(set.span(borrowBytes().data(), length().rep()));
+  }
+
+  // borrow this.
+  // The number of bytes before the first one that is in the set.
+  // This is the length of the input, if no bytes are in the set.
+  Size findFirstOf(ByteSet const &set) const {
+    return Size::from(set.find(borrowBytes().data(), length().rep()));
   }
 
   // XXX: We need to esacpe quotes in the input name
@@ -156,13 +185,10 @@ public:
   }
 
 
+  // Borrows this.  The result shares the bytes of the input.
   Array<UInt<8>> getByteArray() {
-    if (offset == 0) {
-      bytes.copy(); return bytes;
-    }
-
-    auto off = offset.rep();
-    return Array{bytes.borrowData() + off, bytes.size().rep() - off};
+    bytes.copy();
+    return bytes.slice(offset, length());
   }
 
   Array<UInt<8>> getName()          { name.copy(); return name; }
@@ -1,4 +1,428 @@
-#error "XXX: Small int is out of date"
+#ifndef DDL_INT_H
+#define DDL_INT_H
 
+// Integers that fit in 63 bits are stored directly in the `Integer` object,
+// and only larger values are stored in a reference-counted GMP integer.
+// Results that fit in 63 bits are always stored directly, so a given
+// value has a unique representation.
 
+#include <cstdint>
+#include <limits>
+#include <gmpxx.h>
+#include <ddl/debug.h>
+#include <ddl/boxed.h>
+#include <ddl/size.h>
+#include <ddl/number.h>
 
+namespace DDL {
+
+class Integer : public IsBoxed {
+
+  // If the lowest bit is 1, then the rest of the bits are a small value.
+  // Otherwise, this is a pointer to a big value.
+  uintptr_t rep;
+
+  using Big = BoxedValue<mpz_class>;
+
+  static_assert(sizeof(uintptr_t) == sizeof(int64_t));
+
+  static constexpr int64_t smallMax = (int64_t(1) << 62) - 1;
+  static constexpr int64_t smallMin = -(int64_t(1) << 62);
+
+  Big *big() const { return reinterpret_cast<Big*>(rep); }
+
+  explicit Integer(Big *p) : rep(reinterpret_cast<uintptr_t>(p)) {}
+
+  // Result of a big computation.  Owns the box.
+  static Integer fromBig(Big *p) {
+    mpz_srcptr v = p->value.get_mpz_t();
+    if (mpz_fits_slong_p(v)) {
+      long x = mpz_get_si(v);
+      if (fitsSmall(x)) { shallow_free_boxed(p); return fromSmall(x); }
+    }
+    return Integer(p);
+  }
+
+  // Make a new big value
+  static Integer fromMpz(mpz_class &&x) { return fromBig(new Big(x)); }
+
+  template <typename rep>
+  rep toUnsigned() const {
+    if (isSmall()) return static_cast<rep>(getSmall());
+    mpz_t r;
+    mpz_init(r);
+    mpz_fdiv_r_2exp(r, big()->value.get_mpz_t(),8*sizeof(rep));
+
+    rep result = 0;
+    mpz_export(&result, NULL, 1, sizeof(rep), 0, 0, r);
+    mpz_clear(r);
+    return result;
+  }
+
+  template <typename sign, typename usign>
+  sign toSigned() const {
+    static_assert(sizeof(sign) == sizeof(usign));
+    return static_cast<sign>(toUnsigned<usign>());
+  }
+
+  void fromUnsigned(uint64_t x) {
+    if (x <= static_cast<uint64_t>(smallMax)) { rep = tag(x); return; }
+    Big *p = new Big();
+    mpz_import(p->value.get_mpz_t(), 1, 1, 8, 0, 0, &x);
+    rep = reinterpret_cast<uintptr_t>(p);
+  }
+
+  void fromSigned(int64_t x) {
+    if (fitsSmall(x)) { rep = tag(x); return; }
+    Big *p = new Big();
+    mpz_class &c = p->value;
+    if (x > 0) {
+      mpz_import(c.get_mpz_t(), 1, 1, 8, 0, 0, &x);
+    } else {
+      uint64_t v = std::numeric_limits<uint64_t>::max() -
+                   static_cast<uint64_t>(x);
+      mpz_import(c.get_mpz_t(), 1, 1, 8, 0, 0, &v);
+      c = -c - 1;
+    }
+    rep = reinterpret_cast<uintptr_t>(p);
+  }
+
+  static uintptr_t tag(int64_t x) {
+    return (static_cast<uintptr_t>(x) << 1) | 1;
+  }
+
+public:
+  static bool fitsSmall(int64_t x) { return smallMin <= x && x <= smallMax; }
+
+  // Assumes that the value fits
+  static Integer fromSmall(int64_t x) { Integer i; i.rep = tag(x); return i; }
+
+  bool    isSmall()  const { return (rep & 1) != 0; }
+  int64_t getSmall() const { return static_cast<int64_t>(rep) >> 1; }
+
+  // Get the value as a GMP integer.
+  mpz_class asMpz() const {
+    if (isSmall()) return mpz_class(static_cast<long>(getSmall()));
+    return big()->value;
+  }
+
+  // Borrow this.  Only valid for big values.
+  mpz_class &getBig() { return big()->value; }
+
+
+  Integer()                 : rep(1) {}
+  Integer(const char* str) {
+    mpz_class v(str);
+    *this = fromMpz(std::move(v));
+  }
+
+  // unsigned constructors
+  Integer(uint8_t x)  : rep(tag(x)) {}
+  Integer(uint16_t x) : rep(tag(x)) {}
+  Integer(uint32_t x) : rep(tag(x)) {}
+  Integer(uint64_t x) { fromUnsigned(x); }
+  Integer(Size x)     { fromUnsigned(x.rep()); }
+
+  // signed constructors
+  Integer(int8_t x)  : rep(tag(x)) {}
+  Integer(int16_t x) : rep(tag(x)) {}
+  Integer(int32_t x) : rep(tag(x)) {}
+  Integer(int64_t x) { fromSigned(x); }
+
+  Integer(mpz_class x) { *this = fromMpz(std::move(x)); }
+
+  Integer(double x) {
+    if (-4.0e18 < x && x < 4.0e18) rep = tag(static_cast<int64_t>(x));
+    else *this = fromMpz(mpz_class(x));
+  }
+  Integer(float  x) : Integer(static_cast<double>(x)) {}
+
+  bool isNatural() const {
+    return isSmall() ? getSmall() >= 0 : sgn(big()->value) >= 0;
+  }
+
+  // Does the value fit in an unsigned integer with this many bits.
+  bool fitsUnsigned(Width bits) const {
+    if (isSmall()) {
+      int64_t v = getSmall();
+      return v >= 0 && (bits >= 63 || v < (int64_t(1) << bits));
+    }
+    mpz_class const &v = big()->value;
+    return sgn(v) >= 0 && mpz_sizeinbase(v.get_mpz_t(), 2) <= bits;
+  }
+
+  // Does the value fit in a signed integer with this many bits.
+  bool fitsSigned(Width bits) const {
+    if (isSmall()) {
+      if (bits == 0) return getSmall() == 0;
+      if (bits >= 63) return true;
+      int64_t v = getSmall();
+      int64_t lim = int64_t(1) << (bits - 1);
+      return -lim <= v && v < lim;
+    }
+    mpz_class const &v = big()->value;
+    if (sgn(v) >= 0) return mpz_sizeinbase(v.get_mpz_t(), 2) < bits;
+    mpz_class c = -v - 1;
+    return sgn(c) == 0 || mpz_sizeinbase(c.get_mpz_t(), 2) < bits;
+  }
+
+  void exportI(uint8_t &x)  { x = toUnsigned<uint8_t>(); }
+  void exportI(uint16_t &x) { x = toUnsigned<uint16_t>(); }
+  void exportI(uint32_t &x) { x = toUnsigned<uint32_t>(); }
+  void exportI(uint64_t &x) { x = toUnsigned<uint64_t>(); }
+
+  void exportI(int8_t &x)  { x = toSigned<int8_t,uint8_t>(); }
+  void exportI(int16_t &x) { x = toSigned<int16_t,uint16_t>(); }
+  void exportI(int32_t &x) { x = toSigned<int32_t,uint32_t>(); }
+  void exportI(int64_t &x) { x = toSigned<int64_t,uint64_t>(); }
+
+  // Used for casting
+  double asDouble() const {
+    return isSmall() ? static_cast<double>(getSmall()) : big()->value.get_d();
+  }
+
+  // Used in array
+  Size asSize() const { return Size{ toUnsigned<size_t>() }; }
+
+
+  // Mutable shift in place.
+  // To be only used when we are the unique owners of this
+  void mutShiftL(Size amt) { *this = *this << amt; }
+
+  // Mutable shift in place.
+  // To be only used when we are the unique owners of this
+  void mutShiftR(Size amt) { *this = *this >> amt; }
+
+  // -- Boxed -----------------------------------------------------------------
+  // Small values behave as if they are always uniquely owned.
+  RefCount refCount() { return isSmall() ? 1 : refGet(big()->ref_count); }
+  void copy()         { if (!isSmall()) copy_boxed(big()); }
+  void free()         { if (!isSmall()) free_boxed(big()); }
+
+  // -- Arithmetic ------------------------------------------------------------
+  // All of these own their arguments.
+
+  // Apply a GMP operation.  If `x` is big and unique we update it in place.
+  template <typename F>
+  static Integer bigOp(Integer x, Integer y, F f) {
+    if (!x.isSmall() && x.refCount() == 1) {
+      Big *p = x.big();
+      if (y.isSmall()) f(p->value, mpz_class(static_cast<long>(y.getSmall())));
+      else { f(p->value, y.big()->value); y.free(); }
+      return fromBig(p);
+    }
+    mpz_class r = x.asMpz();
+    if (y.isSmall()) f(r, mpz_class(static_cast<long>(y.getSmall())));
+    else f(r, y.big()->value);
+    x.free(); y.free();
+    return fromMpz(std::move(r));
+  }
+
+  friend Integer operator + (Integer x, Integer y) {
+    if (x.isSmall() && y.isSmall()) {
+      int64_t r = x.getSmall() + y.getSmall();
+      if (fitsSmall(r)) return fromSmall(r);
+    }
+    return bigOp(x, y, [](mpz_class &a, mpz_class const &b) { a += b; });
+  }
+
+  friend Integer operator - (Integer x, Integer y) {
+    if (x.isSmall() && y.isSmall()) {
+      int64_t r = x.getSmall() - y.getSmall();
+      if (fitsSmall(r)) return fromSmall(r);
+    }
+    return bigOp(x, y, [](mpz_class &a, mpz_class const &b) { a -= b; });
+  }
+
+  friend Integer operator * (Integer x, Integer y) {
+    if (x.isSmall() && y.isSmall()) {
+      int64_t r;
+      if (!__builtin_mul_overflow(x.getSmall(), y.getSmall(), &r)
+          && fitsSmall(r)) return fromSmall(r);
+    }
+    return bigOp(x, y, [](mpz_class &a, mpz_class const &b) { a *= b; });
+  }
+
+  // XXX: Check for division by 0?
+  // Rounds towards 0, like GMP's `/`
+  friend Integer operator / (Integer x, Integer y) {
+    if (x.isSmall() && y.isSmall()) {
+      int64_t r = x.getSmall() / y.getSmall();
+      if (fitsSmall(r)) return fromSmall(r);
+    }
+    return bigOp(x, y, [](mpz_class &a, mpz_class const &b) { a /= b; });
+  }
+
+  // XXX: Check for division by 0?
+  friend Integer operator % (Integer x, Integer y) {
+    if (x.isSmall() && y.isSmall())
+      return fromSmall(x.getSmall() % y.getSmall());
+    return bigOp(x, y, [](mpz_class &a, mpz_class const &b) { a %= b; });
+  }
+
+  friend Integer operator - (Integer x) {
+    if (x.isSmall() && x.getSmall() != smallMin)
+      return fromSmall(-x.getSmall());
+    return bigOp(Integer(), x, [](mpz_class &a, mpz_class const &b) { a -= b; });
+  }
+
+  // Bitwise operations on small values can't overflow.
+  friend Integer operator | (Integer x, Integer y) {
+    if (x.isSmall() && y.isSmall()) return fromSmall(x.getSmall() | y.getSmall());
+    return bigOp(x, y, [](mpz_class &a, mpz_class const &b) { a |= b; });
+  }
+
+  friend Integer operator & (Integer x, Integer y) {
+    if (x.isSmall() && y.isSmall()) return fromSmall(x.getSmall() & y.getSmall());
+    return bigOp(x, y, [](mpz_class &a, mpz_class const &b) { a &= b; });
+  }
+
+  friend Integer operator ^ (Integer x, Integer y) {
+    if (x.isSmall() && y.isSmall()) return fromSmall(x.getSmall() ^ y.getSmall());
+    return bigOp(x, y, [](mpz_class &a, mpz_class const &b) { a ^= b; });
+  }
+
+  // owned, unmanaged
+  friend Integer operator << (Integer x, Size amt) {
+    size_t n = amt.rep();
+    if (x.isSmall()) {
+      int64_t v = x.getSmall();
+      if (v == 0) return x;
+      int64_t r;
+      if (n < 63 && !__builtin_mul_overflow(v, int64_t(1) << n, &r)
+          && fitsSmall(r)) return fromSmall(r);
+    }
+    if (!x.isSmall() && x.refCount() == 1) {
+      x.big()->value <<= n;
+      return x;
+    }
+    mpz_class r = x.asMpz();
+    x.free();
+    r <<= n;
+    return fromMpz(std::move(r));
+  }
+
+  // owned, unmanaged
+  // Rounds towards negative infinity, like GMP's `>>`
+  friend Integer operator >> (Integer x, Size amt) {
+    size_t n = amt.rep();
+    if (x.isSmall()) {
+      int64_t v = x.getSmall();
+      return fromSmall(n >= 63 ? (v < 0 ? -1 : 0) : v >> n);
+    }
+    if (x.refCount() == 1) {
+      Big *p = x.big();
+      p->value >>= n;
+      return fromBig(p);
+    }
+    mpz_class r = x.big()->value >> n;
+    x.free();
+    return fromMpz(std::move(r));
+  }
+
+  // -- Comparisons -----------------------------------------------------------
+  // borrow
+  friend int compare(Integer x, Integer y) {
+    if (x.isSmall() && y.isSmall()) {
+      int64_t a = x.getSmall(), b = y.getSmall();
+      return a < b ? -1 : a == b ? 0 : 1;
+    }
+    if (x.isSmall()) return -mpz_cmp_si(y.big()->value.get_mpz_t(), x.getSmall());
+    if (y.isSmall()) return mpz_cmp_si(x.big()->value.get_mpz_t(), y.getSmall());
+    return cmp(x.big()->value, y.big()->value);
+  }
+
+  // borrow
+  friend bool operator == (Integer x, Integer y) {
+    if (x.isSmall() || y.isSmall()) return x.rep == y.rep;
+    return x.big()->value == y.big()->value;
+  }
+};
+
+static_assert(sizeof(long) == sizeof(int64_t));
+
+
+static inline
+int compare(Integer x, uint32_t y) {
+  return compare(x, Integer{y});
+}
+
+static inline
+int compare(Integer x, int32_t y) {
+  return compare(x, Integer{y});
+}
+
+static inline
+int compare(Integer x, uint64_t y) {
+  Integer i{y};
+  int res = compare(x,i);
+  i.free();
+  return res;
+}
+
+static inline
+int compare(Integer x, int64_t y) {
+  Integer i{y};
+  int res = compare(x,i);
+  i.free();
+  return res;
+}
+
+
+// borrow
+static inline
+bool operator != (Integer x, Integer y) { return !(x == y); }
+
+// borrow
+static inline
+bool operator <  (Integer x, Integer y) { return compare(x,y) <  0; }
+
+// borrow
+static inline
+bool operator <= (Integer x, Integer y) { return compare(x,y) <= 0; }
+
+// borrow
+static inline
+bool operator >  (Integer x, Integer y) { return compare(x,y) >  0; }
+
+// borrow
+static inline
+bool operator >= (Integer x, Integer y) { return compare(x,y) >= 0; }
+
+
+
+// borrow
+static inline
+std::ostream& operator<<(std::ostream& os, Integer x) {
+  if (x.isSmall()) return os << x.getSmall();
+  return os << x.getBig();
+}
+
+// borrow
+static inline
+std::ostream& toJS(std::ostream& os, Integer x) {
+  if (x.isSmall()) return os << std::dec << x.getSmall();
+  return os << std::dec << x.getBig();
+}
+
+
+// owned, unmanaged
+// XXX: remove in favor of size
+static inline
+Integer operator << (Integer x, UInt<64> iamt) {
+  return x << Size::from(iamt.rep());
+}
+
+// owned, unmanaged
+// XXX: remove in favor of size
+static inline
+Integer operator >> (Integer x, UInt<64> iamt) {
+  return x >> Size::from(iamt.rep());
+}
+
+template <Width b>
+Integer lcat(Integer x, UInt<b> y) { return (x << Size{b}) | Integer(y.rep()); }
+
+}
+
+#endif
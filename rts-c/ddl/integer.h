@@ -1,8 +1,11 @@
 #ifndef DDL_INTEGER_H
 #define DDL_INTEGER_H
 
-// #define QUICK_INTEGER
-
+// By default, integers that fit in a machine word are stored without
+// allocating (see `int.h`).  Define DDL_GMP_INTEGER to always use GMP.
+#ifndef DDL_GMP_INTEGER
+#define QUICK_INTEGER
+#endif
 
 
 #ifdef QUICK_INTEGER
@@ -103,6 +106,23 @@ public:
 
   bool isNatural() { return sgn(getValue()) >= 0; }
 
+  // Does the value fit in an unsigned integer with this many bits.
+  bool fitsUnsigned(Width bits) {
+    mpz_class &v = getValue();
+    if (sgn(v) == 0) return true;
+    return sgn(v) > 0 && mpz_sizeinbase(v.get_mpz_t(), 2) <= bits;
+  }
+
+  // Does the value fit in a signed integer with this many bits.
+  bool fitsSigned(Width bits) {
+    mpz_class &v = getValue();
+    if (sgn(v) == 0) return true;
+    if (sgn(v) > 0) return mpz_sizeinbase(v.get_mpz_t(), 2) < bits;
+    mpz_class c = -v - 1;
+    if (sgn(c) == 0) return bits > 0;
+    return mpz_sizeinbase(c.get_mpz_t(), 2) < bits;
+  }
+
   void exportI(uint8_t &x)  { x = toUnsigned<uint8_t>(); }
   void exportI(uint16_t &x) { x = toUnsigned<uint16_t>(); }
   void exportI(uint32_t &x) { x = toUnsigned<uint32_t>(); }
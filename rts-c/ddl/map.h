@@ -7,6 +7,7 @@
 
 #include <assert.h>
 #include <ddl/debug.h>
+#include <ddl/allocator.h>
 #include <ddl/boxed.h>
 #include <ddl/maybe.h>
 
@@ -16,10 +17,10 @@ template <typename Key, typename Value>
 class Map : HasRefs {
 
   // Empty reprsented as a null pointer, which is color black
-  struct Node {
+  struct Node : Allocated {
     using Color = bool;
 
-    RefCount ref_count;
+    RefCounter ref_count;
     Color color;
     Key key;
     Value value;
@@ -47,13 +48,12 @@ class Map : HasRefs {
         copy(right);
       }
 
-    static void copy(Node *n) { if (n != nullptr) ++(n->ref_count); }
+    static void copy(Node *n) { if (n != nullptr) refInc(n->ref_count); }
 
     static void free(Node *n) {
       if (n == nullptr) return;
 
-      RefCount r = n->ref_count;
-      if (r == 1) {
+      if (refDec(n->ref_count)) {
         debugLine("freeing last ref");
         if constexpr (hasRefs<Key>())   n->key.free();
         if constexpr (hasRefs<Value>()) n->value.free();
@@ -62,7 +62,6 @@ class Map : HasRefs {
         delete n;
       } else {
         debugLine("freeing decrement");
-        n->ref_count = r - 1;
       }
 
     }
@@ -103,7 +102,7 @@ class Map : HasRefs {
       for (int i = 0; i < tab; ++i) debug(" ");
       debugVal((void*)n); debug(" ");
       debug(n->color == red ? "R" : "B");
-      debug("("); debugVal(n->ref_count); debug(") ");
+      debug("("); debugVal(refGet(n->ref_count)); debug(") ");
       debug("Key:"); debugVal(n->key); debug(" Val:"); debugValNL(n->value);
       dump(tab + 2, n->right);
     }
@@ -112,8 +111,7 @@ class Map : HasRefs {
     // be unique.  If `p` was already unique than we can reuse it.
     // owns p
     static Node* makeCopy(Node *p) {
-      RefCount ref = p->ref_count;
-      if (ref == 1) return p;
+      if (refGet(p->ref_count) == 1) return p;
 
       Node *res = new Node(p);
       free(p);
@@ -368,11 +366,138 @@ public:
   };
 
 
+  // An exclusive handle to a map, which is updated in place.
+  // Inserting walks down the tree once, making the nodes on the path
+  // unique (which is free if the map was not shared), and then fixes up
+  // the colors bottom-up, so we don't rebuild the path on the way back.
+  // Use `freeze` to get the persistent map back.
+  class Transient {
+    Node *tree;
+
+    // The deepest path in a red-black tree is at most twice the shortest one.
+    static constexpr size_t maxDepth = 2 * 8 * sizeof(size_t) + 1;
+
+    // The field that points to `path[i]`.
+    // `path[i]` should be a child of `path[i-1]`, and the root if `i == 0`.
+    Node*& link(Node **path, size_t i) {
+      if (i == 0) return tree;
+      Node *parent = path[i-1];
+      return parent->left == path[i] ? parent->left : parent->right;
+    }
+
+  public:
+    Transient() : tree(nullptr) {}
+
+    // owns m
+    explicit Transient(Map m) : tree(m.tree) {}
+
+    // owns k, owns v
+    void insert(Key k, Value v) {
+      Node  *path[maxDepth];
+      size_t depth = 0;
+      Node **here  = &tree;
+
+      while (*here != nullptr) {
+        Node *n = Node::makeCopy(*here);
+        *here = n;
+        path[depth++] = n;
+
+        if (k < n->key) { here = &n->left; continue; }
+        if (n->key < k) { here = &n->right; continue; }
+
+        if constexpr (hasRefs<Key>()) k.free();
+        if constexpr (hasRefs<Value>()) n->value.free();
+        n->value = v;
+        return;
+      }
+
+      Node *x = new Node(Node::red, nullptr, k, v, nullptr);
+      *here = x;
+      path[depth] = x;
+
+      // Restore the invariants: `path[i]` is red, and may have a red parent.
+      for (size_t i = depth; i >= 2 && Node::is_red(path[i-1]); ) {
+        Node *p = path[i-1];
+        Node *g = path[i-2];
+        bool onLeft = g->left == p;
+
+        Node *&uncle = onLeft ? g->right : g->left;
+        if (Node::is_red(uncle)) {
+          uncle        = Node::makeCopy(uncle);
+          uncle->color = Node::black;
+          p->color     = Node::black;
+          g->color     = Node::red;
+          i -= 2;
+          continue;
+        }
+
+        Node *&top = link(path, i-2);
+        Node *c    = path[i];
+        g->color   = Node::red;
+        if (onLeft) {
+          if (p->right == c) {        // left-right
+            p->right = c->left;
+            g->left  = c->right;
+            c->left  = p;
+            c->right = g;
+            c->color = Node::black;
+            top      = c;
+          } else {                    // left-left
+            g->left  = p->right;
+            p->right = g;
+            p->color = Node::black;
+            top      = p;
+          }
+        } else {
+          if (p->left == c) {         // right-left
+            p->left  = c->right;
+            g->right = c->left;
+            c->right = p;
+            c->left  = g;
+            c->color = Node::black;
+            top      = c;
+          } else {                    // right-right
+            g->right = p->left;
+            p->left  = g;
+            p->color = Node::black;
+            top      = p;
+          }
+        }
+        break;
+      }
+
+      tree->color = Node::black;
+    }
+
+    // The transient should not be used after this.
+    // returns owned
+    Map freeze() {
+      Node *t = tree;
+      tree = nullptr;
+      return Map(t);
+    }
+
+    void free() { Node::free(tree); tree = nullptr; }
+  };
+
+
   // Make an empty map
   Map() : tree(nullptr) {}
 
   // owns k, v, and this
-  Map insert(Key k, Value v) { return Map(Node::insert(k,v,tree)); }
+  // If we have the only reference to the map, we update it in place,
+  // which is the common case when building a map in a loop.
+  Map insert(Key k, Value v) {
+    if (tree == nullptr || refGet(tree->ref_count) == 1) {
+      Transient t(*this);
+      t.insert(k,v);
+      return t.freeze();
+    }
+    return Map(Node::insert(k,v,tree));
+  }
+
+  // owns this
+  Transient transient() { return Transient(*this); }
 
   // borrow this, borrow k
   bool contains(Key k) { return Node::findNode(k,tree) != nullptr; }
@@ -4,7 +4,10 @@
 #include <cstdint>
 #include <iostream>
 #include <vector>
-#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <utility>
 
 #include <ddl/debug.h>
 #include <ddl/owned.h>
@@ -15,47 +18,123 @@
 
 namespace DDL {
 
+class ParserContextStack;
+
+// A frame of the grammar context: the function we are in, and the
+// functions that got us here by tail calls.
+// Frames are shared between the contexts of the parser, its suspended
+// threads, and the best error so far, so they are reference counted
+// and only copied when a shared frame is modified.
 class ParserContextFrame {
-  char const *cur;
-  std::unordered_map<std::string_view, size_t> history;
+  friend ParserContextStack;
 
-public:
-  explicit ParserContextFrame(char const* fun) : cur(fun) {}
+  RefCounter          ref_count;
+  ParserContextFrame *parent;     // Owned, nullable
+  char const         *cur;
+  std::vector<std::pair<char const*, size_t>> history;
+
+  ParserContextFrame(char const *fun, ParserContextFrame *parent)
+    : ref_count(1), parent(parent), cur(fun) {}
+
+  // Function names are usually the same literal, so we check for
+  // that first.
+  static bool sameFun(char const *x, char const *y) {
+    return x == y || strcmp(x,y) == 0;
+  }
 
   void tailCall(char const* fun) {
-      auto [thing, inserted] = history.insert({cur,1});
-      if (!inserted) thing->second++;
-      cur = fun;
+    bool found = false;
+    for (auto &entry : history) {
+      if (sameFun(entry.first, cur)) { ++entry.second; found = true; break; }
+    }
+    if (!found) history.emplace_back(cur,1);
+    cur = fun;
   }
 
+public:
   char const* get_cur() const { return cur; }
 
+  // The functions we tail called from, and how many times.
   auto const& get_history() const { return history; }
+
+  // How many times was the given function tail called from this frame.
+  size_t tailCalls(char const *fun) const {
+    for (auto const &entry : history)
+      if (sameFun(entry.first, fun)) return entry.second;
+    return 0;
+  }
 };
 
+// The grammar context of a parser.  This is a pointer to the innermost
+// frame, so copying a context (when spawning a thread, or recording an
+// error) is cheap.  The frames are only flattened when we print an error.
 class ParserContextStack {
-  std::vector<ParserContextFrame> stack;
+  ParserContextFrame *top;      // Owned, nullable
+
+  static void release(ParserContextFrame *f) {
+    while (f != nullptr) {
+      if (!refDec(f->ref_count)) return;
+      ParserContextFrame *parent = f->parent;
+      delete f;
+      f = parent;
+    }
+  }
+
+  // Make sure that we are the only ones using the top frame.
+  // Assumes: top != nullptr
+  ParserContextFrame *ownTop() {
+    if (refGet(top->ref_count) == 1) return top;
+    ParserContextFrame *f = new ParserContextFrame(top->cur, top->parent);
+    f->history = top->history;
+    if (f->parent != nullptr) refInc(f->parent->ref_count);
+    release(top);
+    top = f;
+    return f;
+  }
+
 public:
-  ParserContextStack() = default;
+  ParserContextStack() : top(nullptr) {}
+
+  ParserContextStack(ParserContextStack const& other) : top(other.top) {
+    if (top != nullptr) refInc(top->ref_count);
+  }
+
+  ParserContextStack(ParserContextStack&& other) : top(other.top) {
+    other.top = nullptr;
+  }
+
+  ParserContextStack& operator = (ParserContextStack other) {
+    std::swap(top, other.top);
+    return *this;
+  }
+
+  ~ParserContextStack() { release(top); }
 
   void callFun(char const* fun) {
-    stack.emplace_back(fun);
+    top = new ParserContextFrame(fun, top);
   }
 
   void tailCallFun(char const* fun) {
-    if (stack.empty()) callFun(fun);
-    else stack.back().tailCall(fun);
+    if (top == nullptr) callFun(fun);
+    else ownTop()->tailCall(fun);
   }
-  void popFun() { if (!stack.empty()) stack.pop_back(); }
-
-  auto begin() { return stack.begin(); }
-  auto end() { return stack.end(); }
 
-  auto begin() const { return stack.begin(); }
-  auto end() const { return stack.end(); }
+  void popFun() {
+    if (top == nullptr) return;
+    ParserContextFrame *f = top;
+    top = f->parent;
+    if (top != nullptr) refInc(top->ref_count);
+    release(f);
+  }
 
-  auto cbegin() { return stack.cbegin(); }
-  auto cend() { return stack.cend(); }
+  // The frames of the context, starting with the outermost one.
+  std::vector<ParserContextFrame const*> frames() const {
+    std::vector<ParserContextFrame const*> res;
+    for (ParserContextFrame *f = top; f != nullptr; f = f->parent)
+      res.push_back(f);
+    std::reverse(res.begin(), res.end());
+    return res;
+  }
 };
 
 
@@ -88,6 +167,19 @@ struct ParseError {
                          {}
 
 
+  // Would an error of this kind, at this offset, replace the current one?
+  bool improvedBy(bool newIsSys, Size newOffset) const {
+    // user messages takes precedence over system messages
+    if (newIsSys && !is_system_error) return false;
+
+    // if they are the same type, then we check offsets
+    // XXX: comparing offsets only really makes sense for the same input.
+    if (newIsSys == is_system_error && newOffset < input->getOffset())
+      return false;
+
+    return true;
+  }
+
   // Add another error to the set.
   // Borrows newInput, newMsg
   void improve( bool newIsSys
@@ -97,16 +189,7 @@ struct ParseError {
               , ParserContextStack const& newDebugs
               ) {
 
-    // user messages takes precedence over system messages
-    if (newIsSys && !is_system_error) return;
-
-    // if they are the same type, then we check offsets
-    // XXX: comparing offsets only really makes sense for the same input.
-    if (newIsSys == is_system_error) {
-      Size offset    = input->getOffset();
-      Size newOffset = newInput.getOffset();
-      if (newOffset < offset) return;
-    }
+    if (!improvedBy(newIsSys, newInput.getOffset())) return;
 
     // We found a better error.
     is_system_error = newIsSys;
@@ -126,32 +209,28 @@ std::ostream& toJS(std::ostream &os, ParseError<I> const& err) {
   os << "\n, \"offset\": " << inp.getOffset();
   os << "\n, \"context\":\n[";
   bool first = true;
-  for (auto&& frame : err.debugs) {
+  for (auto frame : err.debugs.frames()) {
     if (!first) os << "\n, ";
     first = false;
 
-    auto cur = frame.get_cur();
-    auto const& h = frame.get_history();
-    auto in_hist = h.find(cur);
+    auto cur = frame->get_cur();
+    auto const& h = frame->get_history();
 
     os << "[ ";
 
-    size_t n = 1;
-    if (in_hist != h.end()) {
-      n += in_hist->second;
-    }
+    size_t n = 1 + frame->tailCalls(cur);
     if (n > 1)
       os << "[" << JS(std::string_view(cur)) << ", " << n << "]";
     else
       os << JS(std::string_view(cur));
 
     for (auto &&el : h) {
-      if (el.first == cur) continue;
+      if (el.first == std::string_view(cur)) continue;
       os << "\n, ";
       if (el.second > 1)
-        os << "[" << JS(el.first) << ", " << el.second << "]";
+        os << "[" << JS(std::string_view(el.first)) << ", " << el.second << "]";
       else
-        os << JS(el.first);
+        os << JS(std::string_view(el.first));
     }
     os << "]";
   }
@@ -177,21 +256,17 @@ std::ostream& operator << (std::ostream &os, ParseError<I> const& err) {
   os << std::endl;
   os << "  • Grammar context:";
   os << std::endl;
-  for (auto&& frame : err.debugs) {
+  for (auto frame : err.debugs.frames()) {
     os << "    • ";
 
-    auto cur = frame.get_cur();
+    auto cur = frame->get_cur();
     os << cur;
-    auto const& h = frame.get_history();
-    auto in_hist = h.find(cur);
 
-    if (in_hist != h.end()) {
-      auto n = in_hist->second;
-      if (n > 1) os << " (" << (n+1) << " times)";
-    }
+    auto n = frame->tailCalls(cur);
+    if (n > 1) os << " (" << (n+1) << " times)";
 
-    for (auto &&el : frame.get_history()) {
-      if (el.first == cur) continue;
+    for (auto &&el : frame->get_history()) {
+      if (el.first == std::string_view(cur)) continue;
       os << " " << el.first;
       if (el.second > 1) {
         os << " (" << el.second << " times)";
@@ -5,7 +5,10 @@
 #include <iostream>
 #include <vector>
 #include <optional>
+#include <utility>
+#include <algorithm>
 
+#include <ddl/allocator.h>
 #include <ddl/debug.h>
 #include <ddl/stack.h>
 #include <ddl/parse_error.h>
@@ -14,17 +17,107 @@ namespace DDL {
 
 typedef size_t ThreadId;
 
-template<typename I>
+// Policies for error tracking in the parser state.
+
+// Keep track of the best error and the grammar context.
+struct TrackErrors     { static constexpr bool enabled = true; };
+
+// Only report if the parse succeeded.  Failures are not recorded,
+// so `noteFail`, `pushDebug` and `popDebug` do nothing, and
+// the resulting parse error is always the default one.
+struct NoErrorTracking { static constexpr bool enabled = false; };
+
+// `Stack` is the representation of the parser stack (see `stack.h`).
+// `Errors` is the error tracking policy.
+template< typename I
+        , typename Stack  = ListStack
+        , typename Errors = TrackErrors
+        >
 class ParserState {
 
   ParseError<I> error;
 
-  ListStack           stack;
-  std::vector<Thread> suspended;
+  Stack                      stack;
+  std::vector<Thread<Stack>> suspended;
   ParserContextStack  debugs;
 
+  // A closure that was logically on top of the stack, but was
+  // popped early by `returnYes` or `yield`.  The next `pop` returns it.
+  Closure            *pending;
+
+  // Stack frames are allocated here, so that memory for frames that
+  // are done can be reused by later calls.
+  Arena               frames;
+
+#ifdef DDL_ARENA
+  // The semantic values made by the parser are allocated here
+  // (see `valueArena`).  Results may outlive the parser state,
+  // so we close this arena rather than delete it.
+  Arena              *values;
+#endif
+
+public:
+  // Memory use of the parser.  These are only tracked if the runtime
+  // is compiled with `DDL_PARSER_STATS`, and are 0 otherwise.
+  struct Stats {
+    size_t max_suspended   = 0;   // Most threads suspended at once
+    size_t max_frame_bytes = 0;   // Most bytes in live frames (incl. threads)
+  };
+
+private:
+  Stats               stats;
+
 public:
-  ParserState() {}
+  ParserState() : pending(nullptr) {
+#ifdef DDL_ARENA
+    values = new Arena();
+#endif
+  }
+
+  ParserState(ParserState const&) = delete;
+  ParserState& operator = (ParserState const&) = delete;
+
+  ~ParserState() {
+    if (pending != nullptr) pending->free();
+    stack.free();
+    discardSuspended();
+#ifdef DDL_ARENA
+    values->close();
+#endif
+  }
+
+  // Get ready for another parse.  This frees the stack, the suspended
+  // threads, and the error, but keeps the memory that we have already
+  // allocated for them, so that a single parser state may be used for
+  // many small parses.  The statistics are not reset.
+  // If all values from earlier parses were freed, their memory
+  // is released at once.
+  void reset() {
+    if (pending != nullptr) { pending->free(); pending = nullptr; }
+    stack.free();
+    discardSuspended();
+    debugs = ParserContextStack();
+    error  = ParseError<I>();
+#ifdef DDL_ARENA
+    values->collectShared();
+    if (values->inUse() == 0) values->release();
+#endif
+  }
+
+  // The arena for the values made during a parse, or `nullptr` if the
+  // runtime is not compiled with `DDL_ARENA`.  Entry points make it
+  // the current arena while they run (see `ArenaScope`).  Values allocated
+  // in it may be freed at any time, on any thread, even after the parser
+  // state is gone.
+  Arena* valueArena() {
+#ifdef DDL_ARENA
+    return values;
+#else
+    return nullptr;
+#endif
+  }
+
+  Stats getStats() const { return stats; }
 
   ParseError<I> getParseError() { return error; }
 
@@ -46,9 +139,11 @@ public:
   void say(const char *msg) { debugLine(msg); }
 
   void pushDebug(char const* msg, bool tail = false) {
-    if (tail) debugs.tailCallFun(msg); else debugs.callFun(msg);
+    if constexpr (Errors::enabled) {
+      if (tail) debugs.tailCallFun(msg); else debugs.callFun(msg);
+    }
   }
-  void popDebug() { debugs.popFun(); }
+  void popDebug() { if constexpr (Errors::enabled) debugs.popFun(); }
 
   // Set the "sibling failied" flag in the given thread.
   // Assumes: valid id (i.e., thread has not been resumed)
@@ -56,19 +151,41 @@ public:
 
   // Borrows input and msg
   void noteFail(bool is_sys, char const *loc, I input, Array<UInt<8>> msg) {
-    error.improve(is_sys,loc,input,msg,debugs);
+    if constexpr (Errors::enabled) error.improve(is_sys,loc,input,msg,debugs);
+  }
+
+  // Allocate a stack frame (or a thread closure).
+  template <typename C, typename... Args>
+  C* alloc(Args&&... args) {
+    C *c = ::new (frames.allocate(sizeof(C))) C(std::forward<Args>(args)...);
+    c->pool       = &frames;
+    c->frame_size = sizeof(C);
+#ifdef DDL_PARSER_STATS
+    stats.max_frame_bytes = std::max(stats.max_frame_bytes, frames.inUse());
+#endif
+    return c;
   }
 
   // Function calls
-  void push(Closure *c) { stack = ListStack{ClosureRef{c},stack}; }
-  Closure* pop()        { return stack.pop(stack); }
+  void push(Closure *c) { stack.push(c); }
+
+  Closure* pop() {
+    if (pending == nullptr) return stack.pop();
+    Closure *c = pending;
+    pending = nullptr;
+    return c;
+  }
 
   // Returns the address of the code for the continuation, the closure is on
   // top of the stack. If there were alternative continuations
   // (for the yes/no cases) the other alternative is removed from the stack.
   void* returnPure()  { return stack.retAddr(); }
-  void* returnYes()   { stack = stack.squish(); return stack.retAddr(); }
-  void* returnNo()    { stack.pop(stack)->free(); return stack.retAddr(); }
+  void* returnNo()    { stack.pop()->free(); return stack.retAddr(); }
+  void* returnYes() {
+    pending = stack.pop();
+    stack.pop()->free();
+    return pending->code;
+  }
 
 
   // -- Threads ---------------------------------------------------------------
@@ -77,12 +194,31 @@ public:
   ThreadId spawn(ThreadClosure *c) {
     ThreadId id = suspended.size();
     debug("spawning thread "); debugValNL(id);
-    stack.copy();
+    suspended.push_back(Thread<Stack>(c,stack.share(),debugs));
     debugVal(stack);
-    suspended.push_back(Thread(c,stack,debugs));
+#ifdef DDL_PARSER_STATS
+    stats.max_suspended = std::max(stats.max_suspended, suspended.size());
+#endif
     return id;
   }
 
+  // Discard the suspended threads with ids `from` and above
+  // (i.e., the ones spawned after thread `from - 1`), releasing
+  // their stacks and anything they refer to.  This is for when we know
+  // that these threads would not produce any results that we need.
+  // The ids of the discarded threads should not be used after this.
+  void discardSuspended(ThreadId from = 0) {
+    if (from >= suspended.size()) return;
+    for (size_t i = from; i < suspended.size(); ++i) {
+      suspended[i].closure->free();
+      suspended[i].stack.free();
+    }
+    suspended.erase(suspended.begin() + from, suspended.end());
+  }
+
+  // How many threads are suspended.
+  size_t suspendedCount() const { return suspended.size(); }
+
   // True if there are there are threads to resume
   bool hasSuspended() { return !suspended.empty(); }
 
@@ -91,32 +227,34 @@ public:
   // Returns the address of the code for the continuation.
   // The top suspended thread is removed:
   //    * its stack replaces the current stack
-  //    * its closure is pushed on the *new* current stack.
+  //    * its closure is the next one to be popped.
   void *yield() {
     debugLine("yielding");
-    Thread& t = suspended.back();
+    Thread<Stack>& t = suspended.back();
 
     debugLine("freeing stack");
     debugVal(stack);
 
     stack.free();
-    ThreadClosure *c = t.closure;
-    stack = ListStack(c,t.stack);
+    stack   = std::move(t.stack);
+    pending = t.closure;
+    debugs  = std::move(t.debug);
     suspended.pop_back();
 
     debugLine("new stack");
     debugVal(stack);
 
-    debugs = t.debug;
-
-    return stack.retAddr();
+    return pending->code;
   }
 
 };
 
 
-template <typename I, typename T>
-class ParserStateUser : public ParserState<I> {
+template < typename I, typename T
+         , typename Stack  = ListStack
+         , typename Errors = TrackErrors
+         >
+class ParserStateUser : public ParserState<I,Stack,Errors> {
   T &ustate;
 
 public:
@@ -5,6 +5,10 @@
 #include <cassert>
 #include <limits>
 #include <iostream>
+#include <new>
+#ifdef DDL_ATOMIC_REFCOUNT
+#include <atomic>
+#endif
 
 
 namespace DDL {
@@ -12,6 +16,53 @@ namespace DDL {
 typedef size_t RefCount;    // Used for counting references
 typedef size_t Width;       // Used for type parameters
 
+// The reference count stored in shared values (arrays, boxes, maps,
+// stream chunks).  By default these are not thread safe, so a value
+// should only be used by one thread at a time.  If the runtime is
+// compiled with `DDL_ATOMIC_REFCOUNT` the counts are atomic, and values
+// may be shared between threads (e.g., parsed on one and used on another).
+#ifdef DDL_ATOMIC_REFCOUNT
+typedef std::atomic<RefCount> RefCounter;
+#else
+typedef RefCount RefCounter;
+#endif
+
+// Set a counter in uninitialized memory to 1.
+inline
+void refInit(RefCounter &c) { ::new (&c) RefCounter(1); }
+
+inline
+RefCount refGet(RefCounter const &c) {
+#ifdef DDL_ATOMIC_REFCOUNT
+  return c.load(std::memory_order_acquire);
+#else
+  return c;
+#endif
+}
+
+inline
+void refInc(RefCounter &c) {
+#ifdef DDL_ATOMIC_REFCOUNT
+  c.fetch_add(1, std::memory_order_relaxed);
+#else
+  ++c;
+#endif
+}
+
+// Drop a reference.  Returns `true` if this was the last one, in which
+// case the counter is not changed, and the caller should free the object.
+inline
+bool refDec(RefCounter &c) {
+#ifdef DDL_ATOMIC_REFCOUNT
+  if (c.load(std::memory_order_acquire) == 1) return true;
+  return c.fetch_sub(1, std::memory_order_acq_rel) == 1;
+#else
+  if (c == 1) return true;
+  --c;
+  return false;
+#endif
+}
+
 // This is so we get a type error rather than an implicit cast.
 struct Size {
   size_t value;
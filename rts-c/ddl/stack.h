@@ -1,34 +1,57 @@
 #ifndef DDL_STACK_H
 #define DDL_STACK_H
 
+#include <cassert>
 #include <utility>
 #include <vector>
+#include <ddl/allocator.h>
 #include <ddl/boxed.h>
 #include <ddl/parse_error.h>
 
 namespace DDL {
 
 // Stack frames extend this class with the parameters that need to be saved.
-struct Closure {
+// Closures are also the nodes of the stack: `next` points to the rest of
+// the stack, so pushing a frame needs only a single allocation.
+struct Closure : Allocated {
   RefCount ref_count;
   void     *code;
+  Closure  *next;         // Owned, the rest of the stack (if any)
+  Arena    *pool;         // Where we were allocated, if not with `new`
+  size_t   frame_size;    // Size of the closure, when allocated in a pool
 
-  Closure(void *c) : ref_count(1), code(c) { }
+  Closure(void *c)
+    : ref_count(1), code(c), next(nullptr), pool(nullptr), frame_size(0) { }
   virtual ~Closure() {}
   virtual void freeMembers() = 0;
 
+  // Release a reference to this closure.  If this was the last reference,
+  // then we also release our reference to the rest of the stack.
+  // This is a loop rather than recursion, as stacks can be quite deep.
   void free() {
-    if (ref_count == 1) {
-      freeMembers();
-      delete this;
-    } else {
-      --ref_count;
+    Closure *c = this;
+    while (c != nullptr) {
+      if (c->ref_count != 1) { --c->ref_count; return; }
+      Closure *n = c->next;
+      c->freeMembers();
+      c->release();
+      c = n;
     }
   }
 
   void copy() {
     ++ref_count;
   }
+
+private:
+  // Deallocate a closure with no references
+  void release() {
+    if (pool == nullptr) { delete this; return; }
+    Arena *a = pool;
+    size_t n = frame_size;
+    this->~Closure();
+    a->deallocate(this, n);
+  }
 };
 
 static inline
@@ -37,75 +60,174 @@ std::ostream& operator<<(std::ostream& os, Closure& x) {
   return os;
 }
 
-class ClosureRef : HasRefs {
-  Closure *ptr;
+
+
+// Parser stacks provide the following operations:
+//   void     push(Closure *c)  -- owns c, which should be unique
+//   Closure *pop()             -- stack is not empty, owned result
+//   void    *retAddr()         -- the code of the closure on top of the stack
+//   Stack    share()           -- an owned copy of the stack, for a new thread
+//   void     free()
+
+// A stack of closures, linked through their `next` field.
+// Tails of the stack may be shared between threads.
+class ListStack : HasRefs {
+  Closure *top;     // nullptr for the empty stack
+
 public:
-  ClosureRef() : ptr(nullptr) {}
-  ClosureRef(Closure *p) : ptr(p) {}    // never null
+  ListStack() : top(nullptr) {}
+
+  // owns c.
+  // The closure should be unique, and not already on a stack.
+  void push(Closure *c) {
+    assert(c->ref_count == 1 && c->next == nullptr);
+    c->next = top;
+    top = c;
+  }
+
+  // \(x:xs) -> xs
+  // we get an owned pointer to the closure.
+  Closure *pop() {
+    Closure *x  = top;
+    Closure *xs = x->next;
+    if (x->ref_count == 1) {
+      x->next = nullptr;            // we take over the reference to xs
+    } else if (xs != nullptr) {
+      xs->copy();                   // x still refers to xs
+    }
+    top = xs;
+    return x;
+  }
+
+  void* retAddr() { return top->code; }
+
+  ListStack share() { copy(); return *this; }
+
+  void free() { if (top != nullptr) top->free(); top = nullptr; }
+  void copy() { if (top != nullptr) top->copy(); }
+
+  friend
+  std::ostream& operator<<(std::ostream& os, const ListStack & x) {
+    os << "[stack]\n";
+    for (Closure *p = x.top; p != nullptr; p = p->next) {
+      os << "  " << *p << " -> ";
+      os << "next " << (void*) p->next << std::endl;
+    }
+    os << "[/stack]\n";
+    return os;
+  }
 
-  void copy()         { ptr->copy(); }
-  void free()         { ptr->free(); }
-  Closure *getValue() { return ptr; }
 };
 
-static inline
-std::ostream& operator<<(std::ostream& os, ClosureRef x) {
-  return os << *x.getValue();
-}
 
 
+// A stack stored in contiguous memory.
+// New frames are pushed on a private vector that belongs to the stack.
+// When a thread is spawned, the private frames are frozen in an immutable
+// segment which is shared between the current stack and the new thread.
+// Popping a frame from a shared segment just copies the pointer to the
+// frame, and later pushes go to the (now empty) private vector,
+// so threads that diverge never copy each other's frames.
+// Parsers that do not spawn threads only use the private vector.
+class SegStack : HasRefs {
 
-class ListStack : HasRefs {
-  List<ClosureRef> data;    // XXX: can combine a node a closure
-  ListStack(List<ClosureRef> xs) : data(xs) {}
+  struct Segment {
+    RefCount              ref_count;
+    Segment               *parent;        // Owned, frames below us
+    size_t                parent_size;    // How many of the parent's frames
+    std::vector<Closure*> frames;         // Owned
+
+    Segment(Segment *p, size_t n, std::vector<Closure*> &&fs)
+      : ref_count(1), parent(p), parent_size(n), frames(std::move(fs)) {}
+
+    static void free(Segment *s) {
+      while (s != nullptr) {
+        if (s->ref_count != 1) { --s->ref_count; return; }
+        for (Closure *c : s->frames) c->free();
+        Segment *p = s->parent;
+        delete s;
+        s = p;
+      }
+    }
+  };
+
+  Segment               *shared;        // Owned, may be null
+  size_t                shared_size;    // Frames of `shared` on our stack
+  std::vector<Closure*> frames;         // Owned, our own frames
+
+  // Switch to the parent segment once we've used up the current one.
+  void nextSegment() {
+    while (shared != nullptr && shared_size == 0) {
+      Segment *p = shared->parent;
+      shared_size = shared->parent_size;
+      if (p != nullptr) ++p->ref_count;
+      Segment::free(shared);
+      shared = p;
+    }
+  }
 
 public:
-  ListStack() : data() {}
+  SegStack() : shared(nullptr), shared_size(0) {}
 
-  // owns both arguments
-  ListStack(ClosureRef c, ListStack s)
-    : data(List<ClosureRef>{c,s.data}) {}
+  // owns c
+  void push(Closure *c) { frames.push_back(c); }
 
-  // own this
-  // \(x:xs) -> xs
   // we get an owned pointer to the closure.
-  Closure *pop(ListStack& out) {
-    ClosureRef x;
-    List<ClosureRef> xs;
-    data.uncons(x,xs);
-    out = ListStack{xs};
-    return x.getValue();
+  Closure *pop() {
+    if (!frames.empty()) {
+      Closure *c = frames.back();
+      frames.pop_back();
+      return c;
+    }
+    Closure *c = shared->frames[--shared_size];
+    c->copy();
+    nextSegment();
+    return c;
   }
 
-  // owns this
-  // \(x : xs@(y : ys) -> x : ys
-  ListStack squish() {
-    ClosureRef x, y;
-    List<ClosureRef> xs, ys;
-    data.uncons(x,xs);
-    xs.uncons(y,ys);
-    y.free();
-    return ListStack{x,ys};
+  void* retAddr() {
+    return frames.empty() ? shared->frames[shared_size - 1]->code
+                          : frames.back()->code;
   }
 
-  void* retAddr() { return data.borrowHead().getValue()->code; }
+  SegStack share() {
+    if (!frames.empty()) {
+      shared      = new Segment(shared, shared_size, std::move(frames));
+      shared_size = shared->frames.size();
+      frames      = std::vector<Closure*>();
+    }
+    SegStack s;
+    s.shared      = shared;
+    s.shared_size = shared_size;
+    if (shared != nullptr) ++shared->ref_count;
+    return s;
+  }
 
-  void free() { data.free(); }
-  void copy() { data.copy(); }
+  void free() {
+    for (Closure *c : frames) c->free();
+    frames.clear();
+    Segment::free(shared);
+    shared      = nullptr;
+    shared_size = 0;
+  }
 
   friend
-  std::ostream& operator<<(std::ostream& os, const ListStack & x) {
+  std::ostream& operator<<(std::ostream& os, const SegStack & x) {
     os << "[stack]\n";
-    List<ClosureRef> p = x.data;
-    while (! p.isNull()) {
-      os << "  [" << (void*)p.rawPtr() << "](" << p.refCount() << ")" << p.borrowHead() << " -> ";
-      p = p.borrowTail();
-      os << "next " << (void*) p.rawPtr() << std::endl;
+    for (size_t i = x.frames.size(); i > 0; --i) {
+      os << "  " << *x.frames[i-1] << std::endl;
+    }
+    size_t n = x.shared_size;
+    for (Segment *s = x.shared; s != nullptr; s = s->parent) {
+      os << "  [segment " << (void*)s << "](" << s->ref_count << ")\n";
+      for (size_t i = n; i > 0; --i) {
+        os << "  " << *s->frames[i-1] << std::endl;
+      }
+      n = s->parent_size;
     }
     os << "[/stack]\n";
     return os;
   }
-
 };
 
 
@@ -118,16 +240,17 @@ struct ThreadClosure : public Closure {
   void notify() { notified = true; }
 };
 
+template <typename Stack>
 struct Thread {
   ThreadClosure *closure;
-  ListStack stack;
+  Stack stack;
   ParserContextStack debug;
 
 public:
   Thread( ThreadClosure *c
-        , const ListStack s
+        , Stack &&s
         , ParserContextStack dbg
-        ) : closure(c), stack(s), debug(dbg) {}
+        ) : closure(c), stack(std::move(s)), debug(std::move(dbg)) {}
   void notify() { closure->notify(); }
 
 };
@@ -1,12 +1,20 @@
 #pragma once
 
 #include <cassert>
+#include <cstring>
+#include <algorithm>
 #include <memory>
 #include <functional>
-#include <variant>
+#include <string_view>
+#include <vector>
+#include <new>
+#include <sys/mman.h>
 #include <boost/context/fiber.hpp>
+#include <boost/context/stack_context.hpp>
+#include <boost/context/stack_traits.hpp>
 
 #include <ddl/boxed.h>
+#include <ddl/byteset.h>
 #include <ddl/size.h>
 #include <ddl/number.h>
 #include <ddl/array.h>
@@ -19,20 +27,77 @@ namespace ctx=boost::context;
 using StreamChunkGenericDel = std::function<void(const char*)>;
 using StreamChunkDel        = std::function<void()>;
 
+/// Called with the context and the buffer of a chunk, when the chunk
+/// is no longer needed.
+using StreamChunkRelease    = void (*)(void *ctx, const char *buffer);
+
 /// The data source for a stream
 class StreamData : HasRefs {
 
+  static void callGenericDel(void *del, const char *buffer) {
+    (*static_cast<StreamChunkGenericDel*>(del))(buffer);
+  }
+
+  static void callOwnedDel(void *del, const char *) {
+    auto *f = static_cast<StreamChunkDel*>(del);
+    (*f)();
+    delete f;
+  }
+
+  static void freeArray(void *content, const char *) {
+    Array<UInt<8>>(static_cast<Array<UInt<8>>::Content*>(content)).free();
+  }
+
   class Chunk: HasRefs {
     Size        size;         // Amount of data in this chunk
-    RefCount    ref_count;    // Number of references to this chunk
+    RefCounter  ref_count;    // Number of references to this chunk
     const char* buffer;       // Data for the chunk  (nullable)
     Chunk*      next;         // Next chunk, if any  (nullable)
     ctx::fiber* thunk;        // Where to get more data.
                               // Only meaningful on a terminal thunk
-    std::variant
-      < StreamChunkGenericDel*    // borrowed
-      , StreamChunkDel            // owned
-      > del;
+    StreamChunkRelease release;     // How to release the buffer (nullable)
+    void*              release_ctx; // Argument for `release`
+
+    // Chunks are allocated and freed for every buffer given to a
+    // stream, so we keep the nodes of freed chunks on a per-thread list
+    // and reuse them, rather than going through the global allocator.
+    struct Pool {
+      static constexpr size_t maxSize = 256;
+      void   *free_list = nullptr;
+      size_t  size      = 0;
+      ~Pool() {
+        while (free_list != nullptr) {
+          void *next = *static_cast<void**>(free_list);
+          ::operator delete(free_list);
+          free_list = next;
+        }
+      }
+    };
+
+    static Pool& pool() {
+      static thread_local Pool p;
+      return p;
+    }
+
+  public:
+    static void *operator new(size_t bytes) {
+      Pool &p = pool();
+      if (p.free_list == nullptr) return ::operator new(bytes);
+      void *res   = p.free_list;
+      p.free_list = *static_cast<void**>(res);
+      --p.size;
+      return res;
+    }
+
+    static void operator delete(void *q) {
+      Pool &p = pool();
+      if (p.size >= Pool::maxSize) { ::operator delete(q); return; }
+      *static_cast<void**>(q) = p.free_list;
+      p.free_list = q;
+      ++p.size;
+    }
+
+  private:
 
 
     // A marker for a terminal empty buffer.
@@ -44,10 +109,8 @@ class StreamData : HasRefs {
     /// @return A pointer to the next node, if any.
     Chunk* freeThis() {
       Chunk *res = next;
-      if (buffer != nullptr && buffer != emptyBuffer) {
-        if (del.index() == 0) (*std::get<0>(del))(buffer);
-        else std::get<1>(del)();
-      }
+      if (buffer != nullptr && buffer != emptyBuffer && release != nullptr)
+        release(release_ctx, buffer);
       delete this;
       return res;
     }
@@ -59,7 +122,8 @@ class StreamData : HasRefs {
       , buffer(emptyBuffer)
       , next(nullptr)
       , thunk(nullptr)
-      , del(nullptr)
+      , release(nullptr)
+      , release_ctx(nullptr)
       {}
 
   public:
@@ -72,24 +136,23 @@ class StreamData : HasRefs {
       , buffer(nullptr)
       , next(nullptr)
       , thunk(&getData)
-      , del(nullptr)
+      , release(nullptr)
+      , release_ctx(nullptr)
       {}
 
     /// Make a non-extensible single chunk buffer from the given array
     /// Owns the array
-    Chunk(Array<UInt<8>> data) {
-      auto buf = data.borrowData();
-      if (buf == nullptr) {
-        *this = Chunk();
-      } else {
-        size = data.size();
-        ref_count = 1;
-        buffer = reinterpret_cast<char const*>(buf);
-        next = nullptr;
-        thunk = nullptr;
-        del = StreamChunkDel([data]() mutable { data.free(); });
-      }
-    }
+    Chunk(Array<UInt<8>> data)
+      : size(data.borrowData() == nullptr ? Size(0) : data.size())
+      , ref_count(1)
+      , buffer(data.borrowData() == nullptr
+                  ? emptyBuffer
+                  : reinterpret_cast<char const*>(data.borrowData()))
+      , next(nullptr)
+      , thunk(nullptr)
+      , release(data.borrowData() == nullptr ? nullptr : freeArray)
+      , release_ctx(data.borrowData() == nullptr ? nullptr : data.ptr)
+      {}
 
     /// The address of a staic empty chunk
     static inline Chunk* empty() {
@@ -115,13 +178,13 @@ class StreamData : HasRefs {
     }
 
     /// Add an extra reference.
-    void copy() { ++ref_count; }
+    void copy() { refInc(ref_count); }
 
     /// Remove a reference.
     /// Owns this.
     void free() {
       for (auto p = this; p != empty() && p != nullptr;) {
-        if (p->ref_count > 1) { --(p->ref_count); return; }
+        if (!refDec(p->ref_count)) return;
         p = p->freeThis();
       }
     }
@@ -133,12 +196,17 @@ class StreamData : HasRefs {
     Chunk* nextChunk() {
       assert(!isTerminal());
 
-      if (ref_count > 1) {
-        --ref_count;
-        ++(next->ref_count);
-        return next;
-      } else
-        return freeThis();
+      if (refGet(ref_count) == 1) return freeThis();
+
+      Chunk *n = next;
+      refInc(n->ref_count);
+      if (refDec(ref_count)) {
+        // The other references went away in the mean time,
+        // so we also got the reference from this chunk.
+        freeThis();
+        refDec(n->ref_count);
+      }
+      return n;
     }
 
     /// Assume: !isTerminal()
@@ -169,7 +237,7 @@ class StreamData : HasRefs {
     void dump() const {
       for (auto p = this; p != nullptr; p = p->next) {
         std::cout
-          << "[" << p->ref_count
+          << "[" << refGet(p->ref_count)
           << "|" << (void*) p
           << "|";
         if (p->buffer == nullptr)     std::cout << "thunk"; else
@@ -179,6 +247,14 @@ class StreamData : HasRefs {
       }
     }
 
+    /// @param offset   Offset in the *current* chunk.
+    /// @return         The data starting at the given offset.
+    /// Assumes: offset < size
+    const char *borrowBuffer(Size offset) const {
+      assert(offset < size);
+      return buffer + offset.rep();
+    }
+
     /// Copy `len` bytes, starting at `offset` into the give buffer.
     /// @param out      A buffer to copy the bytes into
     /// @param offset   The index of the first byte to copy
@@ -189,55 +265,30 @@ class StreamData : HasRefs {
       return std::copy_n(buffer + offset.rep(), len.rep(), out);
     }
 
-    /// Append a new chunk of data to the stream.
-    /// Owns this.  Owns buf_del
-    /// When we are done with `cbuffer` we call `buf_del`.
-    /// Assume: isTerminal() && !isEmpty() && thunk != nullptr
-    /// @return An owned reference to the new end of the stream.
-    /// Assert: return != nullptr
-    Chunk* append( Size csize, const char *cbuffer
-                 , StreamChunkDel &&buf_del
-                 ) {
-      assert (isTerminal());
-      assert (!isEmpty());
-      assert (thunk != nullptr);
-
-      if (csize == 0) {
-        buf_del();
-        return this;
-      }
-
-      size    = csize;
-      buffer  = cbuffer;
-      del     = std::move(buf_del);
-      next    = new Chunk(*thunk);
-
-      return nextChunk();
-    }
-
     /// Append a new chunk of data to the stream.
     /// Owns this.
-    /// When we are done with `cbuffer` we call `buf_del(cbuffer)`.
+    /// When we are done with `cbuffer` we call `buf_rel(ctx,cbuffer)`,
+    /// unless `buf_rel` is `nullptr`.
     /// Assume: isTerminal() && !isEmpty() && thunk != nullptr
-    /// Assume: buf_del lives longer then we do (we are borrwoing it).
     /// @return An owned reference to the new end of the stream.
     /// Assert: return != nullptr
     Chunk* append( Size csize, const char *cbuffer
-                 , StreamChunkGenericDel &buf_del
+                 , StreamChunkRelease buf_rel, void *ctx
                  ) {
       assert (isTerminal());
       assert (!isEmpty());
       assert (thunk != nullptr);
 
       if (csize == 0) {
-        buf_del(cbuffer);
+        if (buf_rel != nullptr) buf_rel(ctx, cbuffer);
         return this;
       }
 
-      size    = csize;
-      buffer  = cbuffer;
-      del     = &buf_del;
-      next    = new Chunk(*thunk);
+      size        = csize;
+      buffer      = cbuffer;
+      release     = buf_rel;
+      release_ctx = ctx;
+      next        = new Chunk(*thunk);
 
       return nextChunk();
     }
@@ -287,6 +338,13 @@ public:
     return front->elementAt(offset);
   }
 
+  /// Assume: offset < getChunkSize()
+  /// @param  offset  Offset in the *current* chunk.
+  /// @return         The data of the current chunk, starting at `offset`.
+  const char *borrowChunkData(Size offset) const {
+    return front->borrowBuffer(offset);
+  }
+
   /// Owns this.
   /// Append new buffer.
   /// The data stream is updated to point to the new end of stream.
@@ -294,11 +352,20 @@ public:
   /// @param cbuffer  Data associate with the buffer.
   /// @param del      How to deallocate the data when we are done with it.
   void appendMut(Size csize, const char *cbuffer, StreamChunkGenericDel &d) {
-    front = front->append(csize, cbuffer, d);
+    front = front->append(csize, cbuffer, callGenericDel, &d);
   }
 
   void appendMut(Size csize, const char *cbuffer, StreamChunkDel &&d) {
-    front = front->append(csize, cbuffer, std::move(d));
+    front = front->append( csize, cbuffer
+                         , callOwnedDel, new StreamChunkDel(std::move(d)));
+  }
+
+  /// Like the other versions, but does not allocate.
+  /// @param rel      Called with `ctx` and the buffer, when we are done
+  ///                 with the data (`nullptr` if nothing needs to be done).
+  void appendMut( Size csize, const char *cbuffer
+                , StreamChunkRelease rel, void *ctx) {
+    front = front->append(csize, cbuffer, rel, ctx);
   }
 
   void finishMut() { front->finish(); }
@@ -379,6 +446,15 @@ class Stream : HasRefs {
   Array<UInt<8>> name;
   /// Name for the stream
 
+  const char *window;
+  /// The data of the current chunk, if `chunk_size > 0`.
+  /// This is cached here so that the common case of accessing bytes
+  /// in the current chunk does not need to look at the chunks.
+
+  void setWindow() {
+    window = chunk_size > 0 ? data.borrowChunkData(0) : nullptr;
+  }
+
 
   /// Do this when this stream is known to be empty to
   /// let go of the underlying stream
@@ -388,6 +464,7 @@ class Stream : HasRefs {
     chunk_offset = getOffset();
     offset       = 0;
     chunk_size   = 0;
+    window       = nullptr;
   }
 
   /// Adjust the size of the current chunk.
@@ -395,6 +472,7 @@ class Stream : HasRefs {
     chunk_size   = data.getChunkSize();
     Size have    = last_offset.decrementedBy(global);
     if (chunk_size > have) chunk_size = have;
+    setWindow();
   }
 
   /// Assumes: !data.isTerminal()
@@ -421,7 +499,8 @@ public:
     , offset(0)
     , chunk_size(0)
     , last_offset(0)
-    , name() {}
+    , name()
+    , window(nullptr) {}
 
   /// Make a new stream using the given data source, starting at offset 0.
   /// @param data  The data to back the stream.  Owned.
@@ -432,7 +511,7 @@ public:
     , chunk_size(data.size())
     , last_offset(data.size())
     , name(name)
-  {}
+  { setWindow(); }
 
 
   /// Make a new stream using the given data source, starting at offset 0.
@@ -444,7 +523,7 @@ public:
     , chunk_size(data.getChunkSize())
     , last_offset(Size::maxValue())
     , name(name)
-  {}
+  { setWindow(); }
 
   /// Add an extre reference.
   void copy()       { data.copy(); name.copy(); }
@@ -483,7 +562,8 @@ public:
   /// Assume: !isEmpty()
   /// @return The front element of the stream.
   UInt<8> iHead() const {
-    return data.elementAt(offset);
+    assert(offset < chunk_size);
+    return UInt<8>(window[offset.rep()]);
   }
 
   bool iDropMut1() {
@@ -493,6 +573,27 @@ public:
     return true;
   }
 
+  /// The bytes that are available without getting more data.
+  /// This may be shorter than the stream, and it is empty at the end of
+  /// a chunk, so an empty window does not mean that the stream is empty.
+  /// Use `isEmpty` to get more data.
+  /// Borrows this.  The result is valid as long as this stream is.
+  std::string_view borrowWindow() const {
+    if (chunk_size == 0) return std::string_view();
+    return std::string_view( window + offset.rep()
+                           , chunk_size.decrementedBy(offset).rep()
+                           );
+  }
+
+  /// Consume some of the bytes of the current window.
+  /// Mutable owns this.
+  /// Assumes: n <= borrowWindow().size()
+  void dropWindowMut(Size n) {
+    assert(n <= chunk_size.decrementedBy(offset));
+    offset.incrementBy(n);
+    if (offset == chunk_size && n > 0) advance();
+  }
+
   /// Advance the current offset by this much.
   /// Mutable own this.
   /// @param nHow many bytes to advance by.
@@ -537,8 +638,8 @@ public:
     if (n >= have) return;
 
     last_offset = global.incrementedBy(n);
-    have = have.decrementedBy(n);
-    if (chunk_size > have) chunk_size = have;
+    Size limit  = offset.incrementedBy(n);    // relative to the chunk
+    if (chunk_size > limit) chunk_size = limit;
   }
 
   /// Create a new stream that is the same as the current one,
@@ -585,17 +686,78 @@ public:
   /// and `false` if they are not.
   bool hasPrefix(Array<UInt<8>> pref) {
     Size n = pref.size();
+    if (n == 0) return true;
+    auto *want = reinterpret_cast<char const*>(pref.borrowData());
+
+    // Common case: the prefix is in the current chunk.
+    auto win = borrowWindow();
+    if (n.rep() <= win.size()) return memcmp(win.data(), want, n.rep()) == 0;
+
     Stream peek(*this);
     peek.copy();
     bool yes = true;
-    for (Size i = 0; i < n; i.increment()) {
-      if (peek.isEmpty() || peek.iHead() != pref[i]) { yes = false; break; }
-      peek.iDropMut1();
+    while (n > 0) {
+      if (peek.isEmpty()) { yes = false; break; }
+      auto win  = peek.borrowWindow();
+      Size have = Size::from(win.size());
+      if (have > n) have = n;
+      if (memcmp(win.data(), want, have.rep()) != 0) { yes = false; break; }
+      want += have.rep();
+      n.decrementBy(have);
+      peek.dropWindowMut(have);
     }
     peek.free();
     return yes;
   }
 
+  /// The number of bytes at the start of the stream that are in the set.
+  /// May suspend.
+  /// Borrows this.
+  Size spanOf(ByteSet const &set) {
+    return scanWindows([&set](std::string_view win) {
+             return set.span(win.data(), win.size());
+           });
+  }
+
+  /// The number of bytes before the first one that is in the set.
+  /// This is the length of the stream, if no bytes are in the set.
+  /// May suspend.
+  /// Borrows this.
+  Size findFirstOf(ByteSet const &set) {
+    return scanWindows([&set](std::string_view win) {
+             return set.find(win.data(), win.size());
+           });
+  }
+
+private:
+  /// Scan the stream one window at a time.  `scan` returns how many
+  /// bytes of the window it went over; we stop at the first window
+  /// that it does not go over completely.
+  /// May suspend.
+  /// Borrows this.
+  template <typename Scan>
+  Size scanWindows(Scan scan) {
+    // Common case: we stop in the current chunk.
+    auto win = borrowWindow();
+    size_t k = scan(win);
+    if (k < win.size()) return Size::from(k);
+
+    Size total = Size::from(k);
+    Stream peek(*this);
+    peek.copy();
+    peek.dropWindowMut(Size::from(k));
+    while (!peek.isEmpty()) {
+      win = peek.borrowWindow();
+      k   = scan(win);
+      total.incrementBy(Size::from(k));
+      if (k < win.size()) break;
+      peek.dropWindowMut(Size::from(k));
+    }
+    peek.free();
+    return total;
+  }
+
+public:
   Array<UInt<8>> getName()          { name.copy(); return name; }
   Array<UInt<8>> borrowName() const { return name; }
   std::string_view borrowNameBytes() const { return name.borrowBytes(); }
@@ -695,6 +857,101 @@ bool operator >= (Stream xs, Stream ys) { return !(xs < ys); }
 
 
 
+/// Machine stacks for the fibers of parser threads.
+/// A parser thread that is waiting for input keeps its own stack, so when
+/// there are many parser threads (e.g., one per connection) reusing stacks
+/// from a pool avoids mapping a fresh stack for each of them.
+///
+/// Parser functions that do not capture the stack call each other on the
+/// machine stack, so a parser thread uses as much of its stack as the
+/// deepest nesting of such calls in the grammar and the input.  The pages
+/// of a stack are only backed by memory once they are touched, and are
+/// given back to the system when the parser thread finishes, so a parser
+/// thread costs memory for the deepest its stack got, not for `stackSize`.
+/// The pool keeps at most `maxPooled` free stacks; the others are unmapped.
+///
+/// Each stack has a guard page below it, so a parser that runs out of
+/// stack crashes, rather than overwriting another stack.
+/// If that happens, use a larger `stackSize`.
+///
+/// Copies share the same pool, which should only be used by one thread.
+class ParserStacks {
+
+  /// Stacks that are not in use.
+  struct Pool {
+    size_t             size;      /// Bytes in a stack, incl. the guard page
+    size_t             max_free;  /// Keep at most this many free stacks
+    std::vector<void*> free;      /// Start of the mapping of each stack
+
+    Pool(size_t n, size_t m) : size(n), max_free(m) {}
+    Pool(Pool const&) = delete;
+    Pool& operator = (Pool const&) = delete;
+    ~Pool() { for (void *p : free) munmap(p, size); }
+  };
+
+public:
+  static constexpr size_t defaultStackSize = 256 * 1024;
+  static constexpr size_t defaultMaxPooled = 64;
+
+  /// A stack allocator, suitable for `ctx::fiber`.
+  class Allocator {
+    std::shared_ptr<Pool> pool;
+
+  public:
+    Allocator(std::shared_ptr<Pool> p) : pool(std::move(p)) {}
+
+    ctx::stack_context allocate() {
+      void *p;
+      if (pool->free.empty()) {
+        p = mmap(nullptr, pool->size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) throw std::bad_alloc();
+        // Stacks grow down, so the guard goes at the start.
+        if (mprotect(p, ctx::stack_traits::page_size(), PROT_NONE) != 0) {
+          munmap(p, pool->size);
+          throw std::bad_alloc();
+        }
+      } else {
+        p = pool->free.back();
+        pool->free.pop_back();
+      }
+      ctx::stack_context sc;
+      sc.size = pool->size;
+      sc.sp   = static_cast<char*>(p) + pool->size;
+      return sc;
+    }
+
+    void deallocate(ctx::stack_context &sc) {
+      char *p = static_cast<char*>(sc.sp) - sc.size;
+      if (pool->free.size() >= pool->max_free) { munmap(p, sc.size); return; }
+      size_t guard = ctx::stack_traits::page_size();
+      madvise(p + guard, sc.size - guard, MADV_DONTNEED);
+      pool->free.push_back(p);
+    }
+  };
+
+private:
+  std::shared_ptr<Pool> pool;
+
+public:
+  /// @param stackSize  The size of each stack, not counting the guard page.
+  /// @param maxPooled  How many free stacks to keep for reuse.
+  ParserStacks( size_t stackSize = defaultStackSize
+              , size_t maxPooled = defaultMaxPooled
+              ) {
+    size_t page = ctx::stack_traits::page_size();
+    size_t n    = std::max(stackSize, ctx::stack_traits::minimum_size());
+    pool = std::make_shared<Pool>((n + page - 1) / page * page + page,
+                                  maxPooled);
+  }
+
+  Allocator allocator() const { return Allocator(pool); }
+
+  /// How many free stacks are kept for reuse.
+  size_t pooled() const { return pool->free.size(); }
+};
+
+
 /// Encapsulates the interaction between a parser and a separate corouting
 /// that fills the parser's data stream.
 class ParserThread {
@@ -703,6 +960,18 @@ class ParserThread {
   StreamChunkGenericDel del;       /// Use this to deallocate buffers
   bool                  done;      /// Is the parser finished parsing.
 
+  /// The code for the parser's fiber.
+  template <typename Fn>
+  auto body(Array<UInt<8>> name, Fn &&parser) {
+    return [this,name,parser] (ctx::fiber &&top) {
+             context = std::move(top);
+             data.copy();
+             parser(Stream(name,data));
+             done = true;
+             return std::move(context);
+           };
+  }
+
 public:
 
   /// Initialize the data stream.
@@ -745,19 +1014,38 @@ public:
   ///               Will be called with a Stream value
   template <typename Fn>
   ParserThread(Array<UInt<8>> name, StreamChunkGenericDel &&d, Fn &&parser)
-    : context(
-        [this,name,parser] (ctx::fiber &&top) {
-          context = std::move(top);
-          data.copy();
-          parser(Stream(name,data));
-          done = true;
-          return std::move(context);
-        })
+    : context(body(name, std::forward<Fn>(parser)))
     , data(StreamData(context))
     , del(std::move(d))
     , done(false)
     {}
 
+  /// Initialize the data stream, using a stack from the given pool.
+  /// Owns name
+  /// @param parser The consumer of the stream.
+  ///               Will be called with a Stream value
+  template <typename Fn>
+  ParserThread( ParserStacks const &stacks
+              , Array<UInt<8>> name, StreamChunkGenericDel &&d, Fn &&parser)
+    : context( std::allocator_arg, stacks.allocator()
+             , body(name, std::forward<Fn>(parser)))
+    , data(StreamData(context))
+    , del(std::move(d))
+    , done(false)
+    {}
+
+  /// Initialize the data stream, using a stack from the given pool.
+  /// @param parser The consumer of the stream.
+  ///               Will be called with a Stream value
+  template <typename Fn>
+  ParserThread(ParserStacks const &stacks, const char* name, Fn &&parser)
+    : ParserThread
+        ( stacks
+        , Array{reinterpret_cast<UInt<8> const*>(name), strlen(name)}
+        , [](const char* _x) { assert(false); }
+        , std::move(parser)
+        ) {}
+
 
 
   ~ParserThread() { data.free(); }
@@ -781,6 +1069,14 @@ public:
     data.appendMut(csize, bytes, std::move(d));
   }
 
+  /// Provide more data to the parser, with a custom release function.
+  /// When we are done with the data we call `rel(ctx,bytes)`.
+  /// This avoids allocating a closure for each chunk.
+  void append( size_t csize, const char* bytes
+             , StreamChunkRelease rel, void *ctx) {
+    data.appendMut(csize, bytes, rel, ctx);
+  }
+
 
 
   /// Terminate the data stream.
@@ -2,10 +2,33 @@
 #define DDL_UTILS_H
 
 #include <vector>
+#include <cstdint>
 #include <ddl/parser.h>
 
 namespace DDL {
 
+// Collects the results of an entry point.
+// Once `limit` results have been found, the parser stops exploring
+// the remaining alternatives.
+template <typename T>
+class ResultSink {
+  std::vector<T> &results;
+  size_t          limit;
+public:
+  ResultSink(std::vector<T> &results, size_t limit = SIZE_MAX)
+    : results(results), limit(limit) {}
+
+  // Owns `x`.  Returns `false` if we don't want any more results.
+  bool push(T x) {
+    results.push_back(x);
+    return !full();
+  }
+
+  bool full() const { return results.size() >= limit; }
+};
+
+
+// Parse with an entry point that should produce exactly one result.
 template <typename I, typename T, typename... Args>
 inline
 bool parseOne
@@ -43,6 +66,48 @@ bool parseOneUser
   return true;
 }
 
+// Like `parseOne`, but for the version of an entry point that sends its
+// results to a sink (`parseFToSink`), so we stop as soon as we find
+// a second result.
+template <typename I, typename T, typename... Args>
+inline
+bool parseOne
+  ( void (*f)(DDL::ParseError<I>&, ResultSink<T>&, Args...)
+  , DDL::ParseError<I>& error
+  , T* out
+  , Args... args
+  ) {
+  std::vector<T> results;
+  ResultSink<T> sink(results, 2);
+  f(error, sink, args...);
+  if (results.size() != 1) {
+    for (auto && x : results) x.free();
+    return false;
+  }
+  *out = results[0];
+  return true;
+}
+
+template <typename I, typename UserState, typename T, typename... Args>
+inline
+bool parseOneUser
+  ( void (*f)(UserState&, DDL::ParseError<I>&, ResultSink<T>&, Args...)
+  , UserState &ustate
+  , DDL::ParseError<I>& error
+  , T* out
+  , Args... args
+  ) {
+  std::vector<T> results;
+  ResultSink<T> sink(results, 2);
+  f(ustate, error, sink, args...);
+  if (results.size() != 1) {
+    for (auto && x : results) x.free();
+    return false;
+  }
+  *out = results[0];
+  return true;
+}
+
 
 
 template<typename T, T tag>
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <ddl/allocator.h>
+#include <ddl/array.h>
+#include <ddl/input.h>
+#include <ddl/map.h>
+#include <ddl/number.h>
+#include <ddl/parser.h>
+
+#include <cstdint>
+#include <vector>
+
+TEST(Arena, Alignment) {
+    DDL::Arena arena;
+    for (size_t n : {1, 7, 16, 24, 100, 513, 4096}) {
+        void *p = arena.allocate(n);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % 16, 0);
+        EXPECT_TRUE(arena.contains(p));
+    }
+}
+
+TEST(Arena, ReuseFreed) {
+    DDL::Arena arena;
+    void *p = arena.allocate(24);
+    EXPECT_EQ(arena.inUse(), 32);
+    arena.deallocate(p, 24);
+    EXPECT_EQ(arena.inUse(), 0);
+    EXPECT_EQ(arena.allocate(20), p);   // same size class
+}
+
+TEST(Arena, LargeObjects) {
+    DDL::Arena arena;
+    void *p = arena.allocate(1 << 20);
+    void *q = arena.allocate(1 << 20);
+    EXPECT_TRUE(arena.contains(p));
+    arena.deallocate(p, 1 << 20);
+    EXPECT_FALSE(arena.contains(p));
+    EXPECT_TRUE(arena.contains(q));
+    arena.release();
+    EXPECT_FALSE(arena.contains(q));
+}
+
+TEST(Arena, Release) {
+    DDL::Arena arena;
+    for (size_t i = 0; i < 10000; ++i) arena.allocate(64);
+    arena.release();
+    void *p = arena.allocate(64);
+    EXPECT_TRUE(arena.contains(p));
+}
+
+TEST(Arena, Scope) {
+    DDL::Arena arena;
+    {
+        DDL::ArenaScope scope(arena);
+
+        DDL::Array<DDL::UInt<8>> a{1,2,3};
+        EXPECT_TRUE(arena.contains(a.borrowData()));
+
+        DDL::Map<DDL::UInt<8>, DDL::Array<DDL::UInt<8>>> m{};
+        for (uint8_t i = 0; i < 100; ++i) {
+            a.copy();
+            m = m.insert(i, a);
+        }
+        auto x = m.lookup(42);
+        ASSERT_TRUE(x.isJust());
+        EXPECT_EQ(x.borrowValue(), a);
+        x.free();
+        m.free();
+        a.free();
+    }
+    EXPECT_EQ(DDL::currentArena(), nullptr);
+    arena.release();
+}
+
+TEST(Arena, Literals) {
+    DDL::Arena arena;
+    DDL::Array<DDL::UInt<8>> lit;
+    {
+        DDL::ArenaScope scope(arena);
+        lit = DDL::Array<DDL::UInt<8>>::literal(
+                    reinterpret_cast<DDL::UInt<8> const*>("\101\102"), 2);
+        EXPECT_EQ(DDL::currentArena(), &arena);
+    }
+    arena.release();
+    EXPECT_FALSE(arena.contains(lit.borrowData()));
+    EXPECT_EQ(lit.borrowBytes(), "AB");
+    lit.free();
+}
+
+TEST(Arena, ForeignObjects) {
+    std::vector<DDL::UInt<8>> bytes(4096, DDL::UInt<8>(0));
+    DDL::Array<DDL::UInt<8>> small{1,2,3};
+    DDL::Array<DDL::UInt<8>> large(bytes.data(), DDL::Size::from(bytes.size()));
+    DDL::Arena arena;
+    {
+        DDL::ArenaScope scope(arena);
+        small.free();
+        large.free();
+    }
+    EXPECT_EQ(arena.inUse(), 0);
+}
+
+TEST(Arena, FreedAfterScope) {
+    DDL::Arena arena;
+    DDL::Array<DDL::UInt<8>> a;
+    {
+        DDL::ArenaScope scope(arena);
+        a = DDL::Array<DDL::UInt<8>>{1,2,3};
+    }
+    size_t used = arena.inUse();
+    EXPECT_GT(used, 0);
+    a.free();
+    EXPECT_EQ(arena.inUse(), used);     // not collected yet
+    arena.collectShared();
+    EXPECT_EQ(arena.inUse(), 0);
+}
+
+TEST(Arena, Close) {
+    DDL::Arena *arena = new DDL::Arena();
+    DDL::Array<DDL::UInt<8>> a;
+    {
+        DDL::ArenaScope scope(*arena);
+        a = DDL::Array<DDL::UInt<8>>{1,2,3};
+    }
+    arena->close();
+    EXPECT_EQ(a.borrowBytes(), "\1\2\3");
+    a.free();                           // deletes the arena
+}
+
+TEST(Arena, ResultsOutliveParser) {
+    DDL::Array<DDL::UInt<8>> result;
+    {
+        DDL::ParserState<DDL::Input> p;
+        p.reset();
+        DDL::ArenaScope scope(p.valueArena());
+        result = DDL::Array<DDL::UInt<8>>{4,5};
+        EXPECT_TRUE(p.valueArena()->contains(result.borrowData()));
+    }
+    EXPECT_EQ(result.borrowBytes(), "\4\5");
+    result.free();
+}
@@ -2,6 +2,8 @@
 #include <ddl/array.h>
 
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "comparisons.hpp"
 
@@ -80,6 +82,24 @@ TEST(Arrays, SharedBuilders) {
     a1.free();
 }
 
+TEST(Arrays, TransientBuilder) {
+    DDL::Builder<DDL::UInt<8>> b;
+    for (int i = 0; i < 10; i++) { b = {b, i}; }
+
+    // The transient does not change the shared builder.
+    b.copy();
+    auto t = b.transient();
+    for (int i = 10; i < 20; i++) { t.push(i); }
+    DDL::Array<DDL::UInt<8>> a(b), a1(t.freeze());
+
+    EXPECT_EQ(a.size(), 10);
+    EXPECT_EQ(a1.size(), 20);
+    for (int i = 0; i < 20; i++) { EXPECT_EQ(a1[i], i); }
+
+    a.free();
+    a1.free();
+}
+
 
 TEST(Arrays, BorrowBytes) {
   char const *str ="abcd";
@@ -92,3 +112,94 @@ TEST(Arrays, BorrowBytes) {
 }
 
 
+
+namespace {
+int released = 0;
+void countRelease(void *ctx, DDL::UInt<8> *elems, DDL::Size n) {
+  ++released;
+  EXPECT_EQ(ctx, (void*)elems);
+  EXPECT_EQ(n, 3);
+}
+}
+
+TEST(Arrays, External) {
+  DDL::UInt<8> elems[] = {1,2,3};
+  released = 0;
+  auto a = DDL::Array<DDL::UInt<8>>::external(elems, 3, countRelease, elems);
+  EXPECT_EQ(a.borrowData(), elems);               // not copied
+  DDL::Array<DDL::UInt<8>> b{1,2,3};
+  EXPECT_EQ(a, b);
+  b.free();
+  a.copy();
+  a.free();
+  EXPECT_EQ(released, 0);
+  a.free();
+  EXPECT_EQ(released, 1);
+}
+
+TEST(Arrays, Slice) {
+  DDL::Array<DDL::UInt<8>> a{1,2,3,4,5};
+  a.copy();
+  auto s = a.slice(1,3);
+  EXPECT_EQ(s.borrowData(), a.borrowData() + 1);  // shares the elements
+  EXPECT_EQ(s.borrowBytes(), a.borrowBytes(1,3));
+  DDL::Array<DDL::UInt<8>> b{2,3,4};
+  EXPECT_EQ(s, b);
+  b.free();
+
+  // Slices of slices share the original array
+  s.copy();
+  auto t = s.slice(1);
+  EXPECT_EQ(t.size(), 2);
+  EXPECT_EQ(t[0], 3);
+  EXPECT_EQ(a.refCount(), 3);
+  s.free();
+  EXPECT_EQ(a.refCount(), 2);
+  t.free();
+  EXPECT_EQ(a.refCount(), 1);
+  a.free();
+}
+
+TEST(Arrays, SliceWithRefs) {
+  using Bytes = DDL::Array<DDL::UInt<8>>;
+  Bytes x{1}, y{2};
+  x.copy(); y.copy();
+  DDL::Array<Bytes> a{x,y};
+  auto s = a.slice(1);
+  EXPECT_EQ(s[0], y);
+  EXPECT_EQ(y.refCount(), 3);
+  y.free();   // from `s[0]`
+  s.free();
+  EXPECT_EQ(x.refCount(), 1);
+  EXPECT_EQ(y.refCount(), 1);
+  x.free(); y.free();
+}
+
+#ifdef DDL_ATOMIC_REFCOUNT
+TEST(Arrays, SharedBetweenThreads) {
+  using Bytes = DDL::Array<DDL::UInt<8>>;
+  Bytes a{1,2,3};
+  a.copy();
+  Bytes s = a.slice(1);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    s.copy();
+    threads.emplace_back([s]() mutable {
+      for (int i = 0; i < 10000; ++i) {
+        s.copy();
+        Bytes b = s.slice(1);     // shares the base array
+        b.copy();
+        b.free();
+        b.free();
+      }
+      s.free();
+    });
+  }
+  for (auto &t : threads) t.join();
+  EXPECT_EQ(s.refCount(), 1);
+  EXPECT_EQ(a.refCount(), 2);     // from `s`
+  s.free();
+  EXPECT_EQ(a.refCount(), 1);
+  a.free();
+}
+#endif
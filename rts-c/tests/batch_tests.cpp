@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <ddl/batch.h>
+#include <ddl/input.h>
+#include <ddl/number.h>
+
+#include <stdexcept>
+#include <string>
+
+using Len   = DDL::UInt<64>;
+using State = DDL::ParserState<DDL::Input>;
+
+namespace {
+
+// Parses the length of the input, in the style of a generated entry.
+// Fails on empty inputs, and is ambiguous on inputs starting with `?`.
+void parseLength(State &p, DDL::ParseError<DDL::Input> &error,
+                 DDL::ResultSink<Len> &results, DDL::Input i) {
+    p.reset();
+    if (i.length().rep() == 0) {
+        error = p.getParseError();
+    } else if (results.push(Len(i.length().rep())) && i.iHead() == '?') {
+        results.push(Len(0));
+    }
+    i.free();
+}
+
+std::vector<DDL::Input> makeInputs(size_t n) {
+    std::vector<DDL::Input> inputs;
+    for (size_t i = 0; i < n; ++i) {
+        std::string s(i % 7, i % 5 == 0 ? '?' : 'x');
+        inputs.push_back(DDL::Input("batch", s.c_str()));
+    }
+    return inputs;
+}
+
+bool expectOk(size_t i) { return i % 7 != 0 && i % 5 != 0; }
+
+// Like `parseLength`, but throws on inputs of length 3.
+void parseOrThrow(State &p, DDL::ParseError<DDL::Input> &error,
+                  DDL::ResultSink<Len> &results, DDL::Input i) {
+    if (i.length().rep() == 3) {
+        i.free();
+        throw std::runtime_error("length 3");
+    }
+    parseLength(p, error, results, i);
+}
+
+}
+
+TEST(Batch, InputOrder) {
+    size_t const n = 1000;
+    std::vector<size_t> seen;
+    DDL::BatchConfig config;
+    config.workers = 4;
+    config.order   = DDL::BatchOrder::Input;
+    DDL::parseBatch(parseLength, makeInputs(n),
+        [&](size_t i, Len *result, DDL::ParseError<DDL::Input> const&) {
+            EXPECT_EQ(result != nullptr, expectOk(i));
+            if (result != nullptr) {
+                EXPECT_EQ(result->rep(), i % 7);
+            }
+            seen.push_back(i);
+        }, config);
+    ASSERT_EQ(seen.size(), n);
+    for (size_t i = 0; i < n; ++i) EXPECT_EQ(seen[i], i);
+}
+
+TEST(Batch, CompletionOrder) {
+    size_t const n = 1000;
+    std::vector<bool> seen(n, false);
+    size_t ok = 0;
+    DDL::BatchConfig config;
+    config.workers = 4;
+    DDL::parseBatch(parseLength, makeInputs(n),
+        [&](size_t i, Len *result, DDL::ParseError<DDL::Input> const&) {
+            EXPECT_FALSE(seen[i]);
+            seen[i] = true;
+            if (result != nullptr) ++ok;
+        }, config);
+    size_t expected = 0;
+    for (size_t i = 0; i < n; ++i) {
+        EXPECT_TRUE(seen[i]);
+        if (expectOk(i)) ++expected;
+    }
+    EXPECT_EQ(ok, expected);
+}
+
+TEST(Batch, Empty) {
+    size_t calls = 0;
+    DDL::parseBatch(parseLength, std::vector<DDL::Input>(),
+        [&](size_t, Len*, DDL::ParseError<DDL::Input> const&) { ++calls; });
+    EXPECT_EQ(calls, 0);
+}
+
+TEST(Batch, ParseException) {
+    for (auto order : { DDL::BatchOrder::Completion, DDL::BatchOrder::Input }) {
+        DDL::BatchConfig config;
+        config.workers = 4;
+        config.order   = order;
+        EXPECT_THROW(DDL::parseBatch(parseOrThrow, makeInputs(1000),
+            [&](size_t, Len*, DDL::ParseError<DDL::Input> const&) {}, config),
+            std::runtime_error);
+    }
+}
+
+TEST(Batch, ConsumeException) {
+    size_t calls = 0;
+    DDL::BatchConfig config;
+    config.workers = 4;
+    config.order   = DDL::BatchOrder::Input;
+    EXPECT_THROW(DDL::parseBatch(parseLength, makeInputs(1000),
+        [&](size_t i, Len*, DDL::ParseError<DDL::Input> const&) {
+            ++calls;
+            if (i == 10) throw std::runtime_error("input 10");
+        }, config),
+        std::runtime_error);
+    EXPECT_EQ(calls, 11);
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+
+#include <ddl/btree_map.h>
+#include <ddl/array.h>
+#include <ddl/bool.h>
+#include <ddl/number.h>
+
+#include "comparisons.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using Key   = DDL::UInt<32>;
+using Value = DDL::UInt<32>;
+using BMap  = DDL::BTreeMap<Key, Value>;
+
+TEST(BTreeMap, Comparisons) {
+    DDL::BTreeMap<DDL::Bool, DDL::Bool> e {};
+    DDL::BTreeMap<DDL::Bool, DDL::Bool> cases[] {
+        e,
+        e.insert(false,false),
+        e.insert(false,false).insert(true,false),
+        e.insert(false,false).insert(true,true),
+        e.insert(false,true),
+        e.insert(false,true).insert(true,false),
+        e.insert(false,true).insert(true,true),
+        e.insert(true,false),
+        e.insert(true,true),
+    };
+
+    ComparisonsFromOrderedArray(cases);
+
+    for (auto&& x : cases) { x.free(); }
+}
+
+TEST(BTreeMap, Insertion) {
+    std::vector<uint32_t> keys(5000);
+    for (uint32_t i = 0; i < keys.size(); ++i) keys[i] = 2 * i;
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+
+    BMap m {};
+    BMap snapshot {};
+    for (size_t i = 0; i < keys.size(); ++i) {
+        m = m.insert(keys[i], keys[i] + 1);
+        if (i == keys.size() / 2) { m.copy(); snapshot = m; }
+    }
+    EXPECT_TRUE(m.valid());
+    EXPECT_TRUE(snapshot.valid());
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        EXPECT_EQ(m.lookup(keys[i]), DDL::Maybe<Value>(keys[i] + 1));
+        EXPECT_FALSE(m.contains(keys[i] + 1));
+        EXPECT_EQ(snapshot.contains(keys[i]), i <= keys.size() / 2);
+    }
+    m.free();
+    snapshot.free();
+}
+
+TEST(BTreeMap, Replace) {
+    BMap m {};
+    for (uint32_t i = 0; i < 1000; ++i) m = m.insert(i, i);
+    m.copy();
+    BMap m1 = m;
+    for (uint32_t i = 0; i < 1000; i += 3) m1 = m1.insert(i, 7);
+    EXPECT_TRUE(m1.valid());
+    for (uint32_t i = 0; i < 1000; ++i) {
+        EXPECT_EQ(m.lookup(i),  DDL::Maybe<Value>(i));
+        EXPECT_EQ(m1.lookup(i), DDL::Maybe<Value>(i % 3 == 0 ? 7 : i));
+    }
+    m.free();
+    m1.free();
+}
+
+TEST(BTreeMap, Iterator) {
+    BMap m {};
+    for (uint32_t i = 0; i < 2000; ++i) m = m.insert((i * 7919) % 2000, i);
+
+    m.copy();
+    BMap::Iterator it(m);
+    BMap::Iterator saved;
+    uint32_t expect = 0;
+    while (!it.done()) {
+        EXPECT_EQ(it.borrowKey(), Key(expect));
+        if (expect == 1000) { it.copy(); saved = it; }
+        ++expect;
+        it = it.next();
+    }
+    EXPECT_EQ(expect, 2000);
+
+    // A copy of an iterator is not affected by advancing the original.
+    EXPECT_EQ(saved.borrowKey(), Key(1000));
+    saved = saved.next();
+    EXPECT_EQ(saved.borrowKey(), Key(1001));
+    saved.free();
+    it.free();
+    m.free();
+}
+
+TEST(BTreeMap, SharedValues) {
+    using Bytes = DDL::Array<DDL::UInt<8>>;
+    Bytes a{1,2,3};
+    DDL::BTreeMap<Key, Bytes> m {};
+    for (uint32_t i = 0; i < 100; ++i) { a.copy(); m = m.insert(i, a); }
+    m.copy();
+    auto m1 = m;
+    for (uint32_t i = 0; i < 100; i += 2) { a.copy(); m1 = m1.insert(i, a); }
+    // Every node of `m` was copied, so each map has its own references.
+    EXPECT_EQ(a.refCount(), 201);
+    m.free();
+    EXPECT_EQ(a.refCount(), 101);
+    m1.free();
+    EXPECT_EQ(a.refCount(), 1);
+    a.free();
+}
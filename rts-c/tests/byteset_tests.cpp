@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include <ddl/byteset.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Scanner = DDL::ByteSetScan::Fun;
+
+std::vector<Scanner> scanners() {
+  std::vector<Scanner> fs{DDL::ByteSetScan::firstScalar};
+#ifdef DDL_BYTESET_X86
+  if (__builtin_cpu_supports("ssse3")) fs.push_back(DDL::ByteSetScan::firstSSSE3);
+  if (__builtin_cpu_supports("avx2"))  fs.push_back(DDL::ByteSetScan::firstAVX2);
+#endif
+  return fs;
+}
+
+}
+
+TEST(ByteSet, Membership) {
+  auto s = DDL::ByteSet::fromPredicate([](uint8_t b) { return b % 3 == 0; });
+  for (unsigned b = 0; b < 256; ++b) {
+    EXPECT_EQ(s.contains(b), b % 3 == 0);
+    EXPECT_EQ(s.complement().contains(b), b % 3 != 0);
+  }
+  auto t = DDL::ByteSet::range('a','z') | DDL::ByteSet::range(0xf0,0xff);
+  EXPECT_TRUE(t.contains('q'));
+  EXPECT_TRUE(t.contains(0xf3));
+  EXPECT_FALSE(t.contains('A'));
+}
+
+TEST(ByteSet, Scanners) {
+  std::mt19937 gen(7);
+  std::string bytes(1000, '\0');
+  for (auto &c : bytes) c = static_cast<char>(gen());
+
+  for (int round = 0; round < 20; ++round) {
+    // Sets of increasing density
+    DDL::ByteSet s;
+    for (int i = 0; i < round * 12; ++i) s.insert(static_cast<uint8_t>(gen()));
+
+    for (size_t start : {0, 1, 15, 33, 500}) {
+      char const *p = bytes.data() + start;
+      size_t n      = bytes.size() - start;
+      for (bool want : {true, false}) {
+        size_t expect = DDL::ByteSetScan::firstScalar(s, want, p, n);
+        for (auto f : scanners()) EXPECT_EQ(f(s, want, p, n), expect);
+      }
+    }
+  }
+}
+
+TEST(ByteSet, SpanAndFind) {
+  auto digit = DDL::ByteSet::range('0','9');
+  std::string x = std::string(100,'7') + "x12";
+  EXPECT_EQ(digit.span(x.data(), x.size()), 100);
+  EXPECT_EQ(digit.find(x.data() + 100, 3), 1);
+  EXPECT_EQ(digit.find("abc", 3), 3);
+  EXPECT_EQ(digit.span("", 0), 0);
+}
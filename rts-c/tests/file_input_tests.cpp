@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <ddl/file_input.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+
+namespace {
+
+// A temporary file with the given contents.
+struct TempFile {
+  char name[32] = "/tmp/ddl-input-XXXXXX";
+  TempFile(std::string const &contents) {
+    int fd = mkstemp(name);
+    EXPECT_EQ(write(fd, contents.data(), contents.size()), contents.size());
+    close(fd);
+  }
+  ~TempFile() { unlink(name); }
+};
+
+std::string someBytes(size_t n) {
+  std::string s(n, '\0');
+  for (size_t i = 0; i < n; ++i) s[i] = static_cast<char>(i * 31 + i / 7);
+  return s;
+}
+
+}
+
+TEST(FileInput, Mapped) {
+  std::string bytes = someBytes(100000);
+  TempFile f(bytes);
+  DDL::Input i;
+  ASSERT_TRUE(DDL::inputFromFile(f.name, &i, DDL::InputAccess::Random));
+  EXPECT_EQ(i.borrowBytes(), bytes);
+
+  // Slices share the mapping after the input is gone
+  i.iDropMut(DDL::Size{10});
+  auto a = i.getByteArray();
+  i.free();
+  EXPECT_EQ(a.borrowBytes(), std::string_view(bytes).substr(10));
+  a.free();
+}
+
+TEST(FileInput, Empty) {
+  TempFile f("");
+  DDL::Input i;
+  ASSERT_TRUE(DDL::inputFromFile(f.name, &i));
+  EXPECT_EQ(i.length(), 0);
+  i.free();
+}
+
+TEST(FileInput, Missing) {
+  DDL::Input i;
+  EXPECT_FALSE(DDL::inputFromFile("/nonexistent/ddl-input", &i));
+}
+
+TEST(FileInput, Pipe) {
+  std::string bytes = someBytes(300000);    // more than a pipe buffer
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  std::thread writer([&]() {
+    for (size_t done = 0; done < bytes.size(); ) {
+      ssize_t n = write(fds[1], bytes.data() + done, bytes.size() - done);
+      if (n <= 0) break;
+      done += n;
+    }
+    close(fds[1]);
+  });
+
+  DDL::Input i;
+  bool ok = DDL::inputFromFd(fds[0], "pipe", &i);
+  writer.join();
+  close(fds[0]);
+  ASSERT_TRUE(ok);
+  EXPECT_EQ(i.borrowBytes(), bytes);
+  i.free();
+}
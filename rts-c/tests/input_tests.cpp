@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include <ddl/input.h>
+
+namespace {
+bool released = false;
+void release(void *, DDL::UInt<8> *, DDL::Size) { released = true; }
+}
+
+TEST(Input, ZeroCopy) {
+  char const bytes[] = "Hello";
+  released = false;
+  DDL::Input i{"test", bytes, DDL::Size{5}, release, nullptr};
+  EXPECT_EQ(i.borrowBytes().data(), bytes);
+  EXPECT_EQ(i.iHead(), 'H');
+
+  DDL::Input j = i;
+  j.copy();
+  j.iDropMut(DDL::Size{4});
+  EXPECT_EQ(j.iHead(), 'o');
+  i.free();
+  EXPECT_FALSE(released);       // still used by `j`
+  j.free();
+  EXPECT_TRUE(released);
+}
+
+TEST(Input, GetByteArray) {
+  DDL::Input i{"test", "Hello world"};
+  i.iDropMut(DDL::Size{6});
+  i.iTakeMut(DDL::Size{3});
+  auto a = i.getByteArray();
+  EXPECT_EQ(a.borrowBytes(), "wor");
+  EXPECT_EQ(a.borrowData(), (DDL::UInt<8>*)i.borrowBytes().data());
+  a.free();
+  i.free();
+}
+
+TEST(Input, HasPrefix) {
+  DDL::Input i{"test", "Hello world"};
+  DDL::Array<DDL::UInt<8>> yes{'w','o'}, no{'w','x'}, empty{};
+  i.iDropMut(DDL::Size{6});
+  EXPECT_TRUE(i.hasPrefix(yes));
+  EXPECT_FALSE(i.hasPrefix(no));
+  EXPECT_TRUE(i.hasPrefix(empty));
+  i.iTakeMut(DDL::Size{1});
+  EXPECT_FALSE(i.hasPrefix(yes));
+  yes.free(); no.free(); empty.free();
+  i.free();
+}
+
+TEST(Input, Scan) {
+  DDL::Input i{"test", "  \t key = value"};
+  auto space = DDL::ByteSet::fromPredicate([](uint8_t b) { return b == ' ' || b == '\t'; });
+  EXPECT_EQ(i.spanOf(space), 4);
+  EXPECT_EQ(i.findFirstOf(DDL::ByteSet::range('=','=')), 8);
+  i.iTakeMut(DDL::Size{6});
+  EXPECT_EQ(i.findFirstOf(DDL::ByteSet::range('=','=')), 6);
+  i.free();
+}
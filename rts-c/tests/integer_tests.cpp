@@ -1,7 +1,9 @@
 #include "comparisons.hpp"
 #include <ddl/integer.h>
+#include <ddl/cast.h>
 #include <gtest/gtest.h>
 #include <limits>
+#include <sstream>
 
 TEST(Integer, Comparisons) {
     DDL::Integer cases[] {
@@ -13,3 +15,115 @@ TEST(Integer, Comparisons) {
     ComparisonsFromOrderedArray(cases);
     for (auto&& x : cases) { x.free(); }
 }
+
+namespace {
+// Owns x
+std::string str(DDL::Integer x) {
+    std::ostringstream os;
+    os << x;
+    x.free();
+    return os.str();
+}
+
+DDL::Integer big(char const *s) { return DDL::Integer{s}; }
+}
+
+TEST(Integer, Arithmetic) {
+    EXPECT_EQ(str(DDL::Integer{7} + DDL::Integer{-10}), "-3");
+    EXPECT_EQ(str(DDL::Integer{7} - DDL::Integer{10}), "-3");
+    EXPECT_EQ(str(DDL::Integer{-7} * DDL::Integer{6}), "-42");
+    EXPECT_EQ(str(DDL::Integer{-7} / DDL::Integer{2}), "-3");
+    EXPECT_EQ(str(DDL::Integer{-7} % DDL::Integer{2}), "-1");
+    EXPECT_EQ(str(-DDL::Integer{5}), "-5");
+    EXPECT_EQ(str(DDL::Integer{12} & DDL::Integer{10}), "8");
+    EXPECT_EQ(str(DDL::Integer{12} | DDL::Integer{-16}), "-4");
+    EXPECT_EQ(str(DDL::Integer{12} ^ DDL::Integer{10}), "6");
+}
+
+TEST(Integer, Overflow) {
+    int64_t max = std::numeric_limits<int64_t>::max();
+    int64_t min = std::numeric_limits<int64_t>::min();
+    EXPECT_EQ(str(DDL::Integer{max} + DDL::Integer{1}), "9223372036854775808");
+    EXPECT_EQ(str(DDL::Integer{min} - DDL::Integer{1}), "-9223372036854775809");
+    EXPECT_EQ(str(DDL::Integer{max} * DDL::Integer{max}),
+              "85070591730234615847396907784232501249");
+    EXPECT_EQ(str(-DDL::Integer{min}), "9223372036854775808");
+    EXPECT_EQ(str(DDL::Integer{int64_t{1} << 61} * DDL::Integer{2}),
+              "4611686018427387904");
+    EXPECT_EQ(str(DDL::Integer{int64_t{-1} << 62} / DDL::Integer{-1}),
+              "4611686018427387904");
+
+    // Back to small values
+    DDL::Integer x = DDL::Integer{max} + DDL::Integer{1};
+    x.copy();
+    DDL::Integer y = x - DDL::Integer{1};
+    DDL::Integer z{max};
+    EXPECT_EQ(y, z);
+    EXPECT_EQ(str(x - big("9223372036854775800")), "8");
+    y.free();
+    z.free();
+}
+
+TEST(Integer, Shifts) {
+    EXPECT_EQ(str(DDL::Integer{1} << DDL::Size{70}), "1180591620717411303424");
+    EXPECT_EQ(str(DDL::Integer{-3} << DDL::Size{62}), "-13835058055282163712");
+    EXPECT_EQ(str(DDL::Integer{-7} >> DDL::Size{1}), "-4");
+    EXPECT_EQ(str(DDL::Integer{-7} >> DDL::Size{100}), "-1");
+    EXPECT_EQ(str(big("1180591620717411303424") >> DDL::Size{70}), "1");
+    EXPECT_EQ(str(DDL::lcat(DDL::Integer{1}, DDL::UInt<64>{2})),
+              "18446744073709551618");
+}
+
+TEST(Integer, Export) {
+    DDL::Integer x{-1};
+    uint8_t u8;   x.exportI(u8);  EXPECT_EQ(u8, 255);
+    int16_t s16;  x.exportI(s16); EXPECT_EQ(s16, -1);
+    x.free();
+
+    DDL::Integer y = big("18446744073709551617");    // 2^64 + 1
+    uint64_t u64; y.exportI(u64); EXPECT_EQ(u64, 1);
+    EXPECT_EQ(y.asSize(), DDL::Size{1});
+    y.free();
+}
+
+TEST(Integer, Casts) {
+    DDL::Integer x{300};
+    EXPECT_TRUE(DDL::integer_to_uint_maybe<9>(x).isJust());
+    EXPECT_TRUE(DDL::integer_to_uint_maybe<8>(x).isNothing());
+    EXPECT_TRUE(DDL::integer_to_sint_maybe<10>(x).isJust());
+    EXPECT_TRUE(DDL::integer_to_sint_maybe<9>(x).isNothing());
+    x.free();
+
+    DDL::Integer y{-256};
+    EXPECT_TRUE(DDL::integer_to_uint_maybe<64>(y).isNothing());
+    EXPECT_TRUE(DDL::integer_to_sint_maybe<9>(y).isJust());
+    EXPECT_TRUE(DDL::integer_to_sint_maybe<8>(y).isNothing());
+    y.free();
+
+    DDL::Integer z = big("-9223372036854775808");
+    EXPECT_TRUE(DDL::integer_to_sint_maybe<64>(z).isJust());
+    EXPECT_EQ(DDL::integer_to_sint_maybe<64>(z).getValue().rep(),
+              std::numeric_limits<int64_t>::min());
+    z.free();
+
+    DDL::Integer w = big("18446744073709551616");
+    EXPECT_TRUE(DDL::integer_to_uint_maybe<64>(w).isNothing());
+    EXPECT_TRUE(DDL::integer_to_sint_maybe<64>(w).isNothing());
+    w.free();
+}
+
+TEST(Integer, ZeroWidth) {
+    DDL::Integer zero{0};
+    EXPECT_TRUE(zero.fitsSigned(0));
+    EXPECT_TRUE(zero.fitsUnsigned(0));
+    zero.free();
+
+    DDL::Integer one{1};
+    EXPECT_FALSE(one.fitsSigned(0));
+    EXPECT_FALSE(one.fitsUnsigned(0));
+    one.free();
+
+    DDL::Integer neg{-1};
+    EXPECT_FALSE(neg.fitsSigned(0));
+    neg.free();
+}
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <ddl/map.h>
+#include <ddl/array.h>
 #include <ddl/bool.h>
 #include <ddl/number.h>
 
@@ -106,3 +107,33 @@ TEST(Map, Insertion) {
         m1.free();
     } while (std::next_permutation(std::begin(elements), std::end(elements)));
 }
+
+TEST(Map, Transient) {
+    using Bytes = DDL::Array<DDL::UInt<8>>;
+    Bytes a{1,2,3};
+    DDL::Map<DDL::UInt<16>, Bytes> m {};
+    for (int i = 0; i < 100; ++i) {
+        a.copy();
+        m = m.insert(i, a);
+    }
+
+    // The transient copies the parts of `m` that it changes.
+    m.copy();
+    auto t = m.transient();
+    for (int i = 0; i < 1000; ++i) {
+        a.copy();
+        t.insert((i * 7919) % 1000, a);
+    }
+    auto m1 = t.freeze();
+    EXPECT_TRUE(m.valid());
+    EXPECT_TRUE(m1.valid());
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(m.contains(i), i < 100);
+        EXPECT_TRUE(m1.contains(i));
+    }
+
+    m.free();
+    m1.free();
+    EXPECT_EQ(a.refCount(), 1);
+    a.free();
+}
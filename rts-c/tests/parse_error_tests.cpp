@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <ddl/parse_error.h>
+#include <ddl/input.h>
+#include <ddl/parser.h>
+
+#include <sstream>
+
+namespace {
+
+std::vector<std::string> curs(DDL::ParserContextStack const &s) {
+  std::vector<std::string> res;
+  for (auto f : s.frames()) res.push_back(f->get_cur());
+  return res;
+}
+
+}
+
+TEST(ParserContext, CallAndPop) {
+  DDL::ParserContextStack s;
+  s.callFun("A");
+  s.callFun("B");
+  s.tailCallFun("C");
+  EXPECT_EQ(curs(s), (std::vector<std::string>{"A","C"}));
+  s.popFun();
+  EXPECT_EQ(curs(s), (std::vector<std::string>{"A"}));
+  s.popFun();
+  s.popFun();
+  EXPECT_TRUE(s.frames().empty());
+}
+
+TEST(ParserContext, Sharing) {
+  DDL::ParserContextStack s;
+  s.callFun("A");
+  s.callFun("B");
+
+  DDL::ParserContextStack saved = s;      // e.g., a suspended thread
+  s.tailCallFun("C");
+  s.tailCallFun("B");
+  s.popFun();
+  s.callFun("D");
+
+  EXPECT_EQ(curs(saved), (std::vector<std::string>{"A","B"}));
+  EXPECT_EQ(saved.frames().back()->get_history().size(), 0);
+  EXPECT_EQ(curs(s), (std::vector<std::string>{"A","D"}));
+  EXPECT_EQ(saved.frames().front(), s.frames().front());   // shared
+}
+
+TEST(ParserContext, TailCalls) {
+  DDL::ParserContextStack s;
+  s.callFun("A");
+  for (int i = 0; i < 5; ++i) s.tailCallFun("A");
+  s.tailCallFun("B");
+  auto f = s.frames().back();
+  EXPECT_STREQ(f->get_cur(), "B");
+  EXPECT_EQ(f->tailCalls("A"), 6);
+  EXPECT_EQ(f->get_history().size(), 1);
+}
+
+TEST(ParserContext, Print) {
+  DDL::ParserContextStack s;
+  s.callFun("Main");
+  s.callFun("Item");
+  s.tailCallFun("Item");
+  s.tailCallFun("Item");
+
+  DDL::Array<DDL::UInt<8>> msg{'b','a','d'};
+  DDL::ParseError<DDL::Input> err;
+  DDL::Input in("in","xyz");
+  err.improve(false, "here", in, msg, s);
+  msg.free();
+  in.free();
+
+  std::ostringstream js;
+  toJS(js, err);
+  EXPECT_NE(js.str().find("[ \"Main\"]\n, [ [\"Item\", 3]]"), std::string::npos)
+    << js.str();
+
+  std::ostringstream txt;
+  txt << err;
+  EXPECT_NE(txt.str().find("• Item (3 times)"), std::string::npos)
+    << txt.str();
+}
+
+TEST(ParseErrors, Improve) {
+  DDL::ParseError<DDL::Input> err;
+  DDL::Input in("in","xyz");
+  DDL::Array<DDL::UInt<8>> msg{'b','a','d'};
+  DDL::ParserContextStack ctxt;
+
+  in.iDropMut(DDL::Size{2});
+  err.improve(true, "a", in, msg, ctxt);
+  EXPECT_STREQ(err.error_loc, "a");
+  EXPECT_FALSE(err.improvedBy(true, DDL::Size{1}));  // earlier
+  EXPECT_TRUE(err.improvedBy(true, DDL::Size{2}));
+  EXPECT_TRUE(err.improvedBy(false, DDL::Size{0}));  // user error
+
+  err.improve(false, "b", in, msg, ctxt);
+  EXPECT_FALSE(err.improvedBy(true, DDL::Size{3}));
+  in.free();
+  msg.free();
+}
+
+template <typename Errors>
+static
+DDL::ParseError<DDL::Input> failWith() {
+  DDL::ParserState<DDL::Input,DDL::ListStack,Errors> p;
+  DDL::Input in("in","xyz");
+  DDL::Array<DDL::UInt<8>> msg{'b','a','d'};
+  p.pushDebug("Main");
+  p.noteFail(false, "here", in, msg);
+  p.popDebug();
+  in.free();
+  msg.free();
+  return p.finalYield();
+}
+
+TEST(ParseErrors, Tracking) {
+  auto err = failWith<DDL::TrackErrors>();
+  EXPECT_FALSE(err.is_system_error);
+  EXPECT_STREQ(err.error_loc, "here");
+  EXPECT_EQ(err.debugs.frames().size(), 1);
+
+  auto none = failWith<DDL::NoErrorTracking>();
+  EXPECT_TRUE(none.is_system_error);
+  EXPECT_STREQ(none.error_loc, "");
+  EXPECT_TRUE(none.debugs.frames().empty());
+}
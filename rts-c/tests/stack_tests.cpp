@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+
+#include <ddl/parser.h>
+#include <ddl/input.h>
+#include <ddl/array.h>
+#include <ddl/number.h>
+
+using Bytes = DDL::Array<DDL::UInt<8>>;
+
+namespace {
+
+// Some distinct code addresses
+char codeA, codeB, codeC;
+
+struct Frame : public DDL::Closure {
+    Bytes x;
+    Frame(void *code, Bytes x) : DDL::Closure(code), x(x) {}
+    void freeMembers() { x.free(); }
+};
+
+struct Thread : public DDL::ThreadClosure {
+    Thread(void *code) : DDL::ThreadClosure(code) {}
+    void freeMembers() {}
+};
+
+template <typename S>
+class Stacks : public ::testing::Test {};
+
+using StackTypes = ::testing::Types<DDL::ListStack, DDL::SegStack>;
+
+}
+
+TYPED_TEST_SUITE(Stacks, StackTypes);
+
+TYPED_TEST(Stacks, PushPop) {
+    DDL::ParserState<DDL::Input,TypeParam> p;
+    Bytes a{1,2,3};
+    a.copy();
+    p.push(p.template alloc<Frame>(&codeA, a));
+    p.push(p.template alloc<Frame>(&codeB, Bytes{}));
+    EXPECT_EQ(a.refCount(), 2);
+
+    EXPECT_EQ(p.returnPure(), &codeB);
+    p.pop()->free();
+    EXPECT_EQ(p.returnPure(), &codeA);
+    p.pop()->free();
+    EXPECT_EQ(a.refCount(), 1);
+    a.free();
+}
+
+TYPED_TEST(Stacks, ReturnYes) {
+    DDL::ParserState<DDL::Input,TypeParam> p;
+    Bytes a{1,2,3};
+    a.copy();
+    p.push(p.template alloc<Frame>(&codeA, Bytes{}));
+    p.push(p.template alloc<Frame>(&codeB, a));          // no
+    p.push(p.template alloc<Frame>(&codeC, Bytes{}));    // yes
+
+    EXPECT_EQ(p.returnYes(), &codeC);
+    EXPECT_EQ(a.refCount(), 1);                 // the "no" frame is gone
+    p.pop()->free();
+    EXPECT_EQ(p.returnPure(), &codeA);
+    p.pop()->free();
+    a.free();
+}
+
+TYPED_TEST(Stacks, SharedFrames) {
+    DDL::ParserState<DDL::Input,TypeParam> p;
+    Bytes a{1,2,3};
+    a.copy();
+    p.push(p.template alloc<Frame>(&codeA, a));
+    p.push(p.template alloc<Frame>(&codeB, Bytes{}));
+    p.spawn(p.template alloc<Thread>(&codeC));
+
+    // The current thread pops the shared frames.
+    EXPECT_EQ(p.returnNo(), &codeA);
+    p.pop()->free();
+    EXPECT_EQ(a.refCount(), 2);
+
+    // The suspended thread still has them.
+    ASSERT_TRUE(p.hasSuspended());
+    EXPECT_EQ(p.yield(), &codeC);
+    auto *t = static_cast<Thread*>(p.pop());
+    EXPECT_FALSE(t->notified);
+    t->free();
+    EXPECT_EQ(p.returnPure(), &codeB);
+    p.pop()->free();
+    EXPECT_EQ(p.returnPure(), &codeA);
+    p.pop()->free();
+    EXPECT_EQ(a.refCount(), 1);
+    a.free();
+}
+
+TYPED_TEST(Stacks, FreeSuspended) {
+    Bytes a{1,2,3};
+    a.copy();
+    {
+        DDL::ParserState<DDL::Input,TypeParam> p;
+        p.push(p.template alloc<Frame>(&codeA, a));
+        p.spawn(p.template alloc<Thread>(&codeC));
+        p.finalYield();
+    }
+    EXPECT_EQ(a.refCount(), 1);
+    a.free();
+}
+
+TYPED_TEST(Stacks, FreePending) {
+    Bytes a{1,2,3};
+    a.copy();
+    {
+        DDL::ParserState<DDL::Input,TypeParam> p;
+        p.push(p.template alloc<Frame>(&codeA, Bytes{}));
+        p.push(p.template alloc<Frame>(&codeB, a));
+        EXPECT_EQ(p.returnYes(), &codeB);   // leaves a pending closure
+    }
+    EXPECT_EQ(a.refCount(), 1);
+    a.free();
+}
+
+TYPED_TEST(Stacks, Diverge) {
+    DDL::ParserState<DDL::Input,TypeParam> p;
+    Bytes a{1,2,3};
+    a.copy();
+    p.push(p.template alloc<Frame>(&codeA, a));
+    p.spawn(p.template alloc<Thread>(&codeC));
+    p.push(p.template alloc<Frame>(&codeB, Bytes{}));
+    p.spawn(p.template alloc<Thread>(&codeC));
+
+    // Both threads go their own ways
+    p.push(p.template alloc<Frame>(&codeC, Bytes{}));
+    EXPECT_EQ(p.returnNo(), &codeB);
+    p.pop()->free();
+    EXPECT_EQ(p.returnPure(), &codeA);
+    p.pop()->free();
+
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_TRUE(p.hasSuspended());
+        EXPECT_EQ(p.yield(), &codeC);
+        p.pop()->free();
+        p.push(p.template alloc<Frame>(&codeB, Bytes{}));
+        EXPECT_EQ(p.returnNo(), i == 0 ? &codeB : &codeA);
+    }
+    EXPECT_FALSE(p.hasSuspended());
+    EXPECT_EQ(a.refCount(), 2);
+    p.finalYield();
+    EXPECT_EQ(a.refCount(), 1);
+    a.free();
+}
+
+TYPED_TEST(Stacks, DiscardSuspended) {
+    DDL::ParserState<DDL::Input,TypeParam> p;
+    Bytes a{1,2,3};
+    a.copy();
+    p.push(p.template alloc<Frame>(&codeA, a));
+    DDL::ThreadId first = p.spawn(p.template alloc<Thread>(&codeB));
+    p.push(p.template alloc<Frame>(&codeB, Bytes{}));
+    p.spawn(p.template alloc<Thread>(&codeC));
+    p.spawn(p.template alloc<Thread>(&codeC));
+    EXPECT_EQ(p.suspendedCount(), 3);
+
+    // Drop the threads spawned after the first one.
+    p.discardSuspended(first + 1);
+    EXPECT_EQ(p.suspendedCount(), 1);
+#ifdef DDL_PARSER_STATS
+    EXPECT_EQ(p.getStats().max_suspended, 3);
+    EXPECT_GT(p.getStats().max_frame_bytes, 0);
+#endif
+
+    p.pop()->free();
+    p.pop()->free();
+    EXPECT_EQ(a.refCount(), 2);     // still used by the first thread
+    p.discardSuspended();
+    EXPECT_FALSE(p.hasSuspended());
+    EXPECT_EQ(a.refCount(), 1);
+    a.free();
+}
+
+TYPED_TEST(Stacks, Reset) {
+    DDL::ParserState<DDL::Input,TypeParam> p;
+    Bytes a{1,2,3};
+    size_t first_bytes = 0;
+    for (int i = 0; i < 3; ++i) {
+        a.copy();
+        p.push(p.template alloc<Frame>(&codeA, a));
+        p.spawn(p.template alloc<Thread>(&codeB));
+        p.push(p.template alloc<Frame>(&codeB, Bytes{}));
+        p.push(p.template alloc<Frame>(&codeC, Bytes{}));
+        p.pushDebug("f");
+        EXPECT_EQ(p.returnYes(), &codeC);   // leaves a pending closure
+
+        p.reset();
+        EXPECT_FALSE(p.hasSuspended());
+        EXPECT_EQ(a.refCount(), 1);
+        if (i == 0) first_bytes = p.getStats().max_frame_bytes;
+    }
+    // The frames are reused by later parses.
+    EXPECT_EQ(p.getStats().max_frame_bytes, first_bytes);
+    a.free();
+}
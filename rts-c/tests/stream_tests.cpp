@@ -211,9 +211,30 @@ TEST(Streams, Prefix) {
       EXPECT_EQ(free,0);
       EXPECT_FALSE(s.hasPrefix(pref3));
       EXPECT_EQ(free,0);
+      auto pref4 = str("OneTx");
+      EXPECT_FALSE(s.hasPrefix(pref4));
       pref1.free();
       pref2.free();
       pref3.free();
+      pref4.free();
+      s.free();
+  });
+}
+
+
+TEST(Streams, ByteSets) {
+  const char* chunks[] = { "  ", " a=b", "", "cd" };
+
+  doTest(std::size(chunks)
+        , chunks, [](size_t &alloc, size_t &free, DDL::Stream s) {
+      auto space = DDL::ByteSet::range(' ',' ');
+      auto eq    = DDL::ByteSet::range('=','=');
+      auto none  = DDL::ByteSet();
+      EXPECT_EQ(s.spanOf(space), 3);
+      EXPECT_EQ(s.findFirstOf(eq), 4);
+      EXPECT_EQ(s.findFirstOf(none), 8);
+      ASSERT_FALSE(s.isEmpty());
+      EXPECT_EQ(s.iHead(), ' ');      // nothing was consumed
       s.free();
   });
 }
@@ -268,3 +289,130 @@ TEST(Streams, GetBytes) {
 
 
 
+
+TEST(Streams, Window) {
+  const char* chunks[] = { "One", "Two" };
+
+  doTest(std::size(chunks)
+        , chunks, [](size_t &alloc, size_t &free, DDL::Stream s) {
+      EXPECT_EQ(s.borrowWindow(), "");    // no data yet
+      EXPECT_FALSE(s.isEmpty());
+      EXPECT_EQ(s.borrowWindow(), "One");
+      s.dropWindowMut(1);
+      EXPECT_EQ(s.borrowWindow(), "ne");
+      s.dropWindowMut(2);
+      EXPECT_EQ(s.borrowWindow(), "");
+      EXPECT_FALSE(s.isEmpty());
+      EXPECT_EQ(s.borrowWindow(), "Two");
+      s.iTakeMut(2);
+      EXPECT_EQ(s.borrowWindow(), "Tw");
+      EXPECT_EQ(s.iHead(), 'T');
+      s.dropWindowMut(2);
+      EXPECT_TRUE(s.isEmpty());
+      s.free();
+  });
+}
+
+namespace {
+size_t released_chunks = 0;
+void releaseChunk(void *ctx, const char *buf) {
+  EXPECT_EQ(ctx, (void*)buf);
+  ++released_chunks;
+}
+}
+
+TEST(Streams, ReleaseFunction) {
+  const char* chunks[] = { "One", "Two" };
+  released_chunks = 0;
+
+  DDL::ParserThread pt
+     { "Test"
+     , [](DDL::Stream s) {
+         EXPECT_FALSE(s.isEmpty());
+         s = s.iDrop(4);
+         EXPECT_EQ(released_chunks, 1);
+         EXPECT_EQ(s.iHead(), 'w');
+         s.free();
+       }
+     };
+  pt.resume();
+  for (auto c : chunks) {
+    if (pt.isDone()) break;
+    pt.append(strlen(c), c, releaseChunk, (void*)c);
+    pt.resume();
+  }
+  if (!pt.isDone()) { pt.finish(); pt.resume(); }
+  EXPECT_TRUE(pt.isDone());
+  EXPECT_EQ(released_chunks, 2);
+}
+
+TEST(Streams, PooledStacks) {
+  DDL::ParserStacks stacks;
+  size_t parsed = 0;
+  for (int i = 0; i < 3; ++i) {
+    DDL::ParserThread pt
+       { stacks, "Test"
+       , [&parsed](DDL::Stream s) {
+           EXPECT_FALSE(s.isEmpty());
+           EXPECT_EQ(s.iHead(), 'x');
+           ++parsed;
+           s.free();
+         }
+       };
+    pt.resume();
+    pt.append(1, "x", nullptr, nullptr);
+    pt.resume();
+    EXPECT_TRUE(pt.isDone());
+  }
+  EXPECT_EQ(parsed, 3);
+}
+
+TEST(Streams, StacksAreReused) {
+  DDL::ParserStacks stacks;
+  auto alloc = stacks.allocator();
+  auto a = alloc.allocate();
+  EXPECT_GE(a.size, DDL::ParserStacks::defaultStackSize);
+  alloc.deallocate(a);
+  auto b = alloc.allocate();
+  EXPECT_EQ(a.sp, b.sp);
+  alloc.deallocate(b);
+}
+
+TEST(Streams, StacksAreReleased) {
+  DDL::ParserStacks stacks(DDL::ParserStacks::defaultStackSize, 1);
+  auto alloc = stacks.allocator();
+  auto a = alloc.allocate();
+  auto b = alloc.allocate();
+  char *top = static_cast<char*>(a.sp) - 1;
+  *top = 'x';
+  alloc.deallocate(a);
+  alloc.deallocate(b);          // more than the pool keeps
+  EXPECT_EQ(stacks.pooled(), 1);
+
+  // The pages of a pooled stack are given back, so they read as 0.
+  auto c = alloc.allocate();
+  EXPECT_EQ(c.sp, a.sp);
+  EXPECT_EQ(*top, 0);
+  alloc.deallocate(c);
+}
+
+namespace {
+size_t recurse(size_t n) {
+  volatile char frame[256];
+  frame[0] = char(n);
+  return n == 0 ? frame[0] : recurse(n - 1) + frame[0];
+}
+
+void overflowParserStack() {
+  DDL::ParserStacks stacks(16 * 1024);
+  DDL::ParserThread pt
+     { stacks, "Test"
+     , [](DDL::Stream s) { s.free(); recurse(1 << 20); }
+     };
+  pt.resume();
+}
+}
+
+TEST(StreamsDeathTest, StackOverflowHitsGuard) {
+  EXPECT_DEATH(overflowParserStack(), "");
+}
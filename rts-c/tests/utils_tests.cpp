@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <ddl/utils.h>
+#include <ddl/input.h>
+#include <ddl/number.h>
+
+using Byte = DDL::UInt<8>;
+
+namespace {
+
+size_t attempts;
+
+// An ambiguous parser with `n` results, in the style of a generated entry.
+void parseManyToSink(DDL::ParseError<DDL::Input>&,
+                     DDL::ResultSink<Byte> &results, int n) {
+    for (int i = 0; i < n; ++i) {
+        ++attempts;
+        if (!results.push(Byte(i))) return;
+    }
+}
+
+void parseMany(DDL::ParseError<DDL::Input> &error, std::vector<Byte> &results,
+               int n) {
+    DDL::ResultSink<Byte> sink(results);
+    parseManyToSink(error, sink, n);
+}
+
+}
+
+TEST(ResultSink, Limit) {
+    std::vector<Byte> results;
+    DDL::ResultSink<Byte> sink(results, 2);
+    EXPECT_FALSE(sink.full());
+    EXPECT_TRUE(sink.push(Byte(1)));
+    EXPECT_FALSE(sink.push(Byte(2)));
+    EXPECT_TRUE(sink.full());
+    EXPECT_EQ(results.size(), 2);
+}
+
+TEST(ResultSink, AllResults) {
+    DDL::ParseError<DDL::Input> error;
+    std::vector<Byte> results;
+    attempts = 0;
+    parseMany(error, results, 5);
+    EXPECT_EQ(results.size(), 5);
+    EXPECT_EQ(attempts, 5);
+}
+
+TEST(ResultSink, ParseOne) {
+    DDL::ParseError<DDL::Input> error;
+    Byte out;
+
+    attempts = 0;
+    EXPECT_TRUE(DDL::parseOne(parseManyToSink, error, &out, 1));
+    EXPECT_EQ(out, Byte(0));
+
+    // We stop at the second result.
+    attempts = 0;
+    EXPECT_FALSE(DDL::parseOne(parseManyToSink, error, &out, 100));
+    EXPECT_EQ(attempts, 2);
+
+    EXPECT_FALSE(DDL::parseOne(parseManyToSink, error, &out, 0));
+}
+
+TEST(ResultSink, ParseOneVector) {
+    DDL::ParseError<DDL::Input> error;
+    Byte out;
+
+    // The vector version is not overloaded, so its address can be taken.
+    auto f = parseMany;
+    EXPECT_TRUE(DDL::parseOne(f, error, &out, 1));
+    EXPECT_EQ(out, Byte(0));
+
+    // Without a sink we find all results.
+    attempts = 0;
+    EXPECT_FALSE(DDL::parseOne(parseMany, error, &out, 100));
+    EXPECT_EQ(attempts, 100);
+}